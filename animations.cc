@@ -0,0 +1,370 @@
+/* 
+ * Copyright (C) 2012 - Brian Gomes Bascoy
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ * 
+ */
+
+#include "animations.h"
+
+#include <SDL/SDL_image.h>
+
+PIXL_AnimationClock PIXL_animations;
+
+static const char* batch_vertex_source =
+	"#version 120\n"
+	"attribute vec2 corner;\n"
+	"attribute vec4 instance; // x, y, row, start\n"
+	"attribute vec2 timing; // ms per frame, loop\n"
+	"uniform float time;\n"
+	"uniform vec2 sprite; // size in pixels\n"
+	"uniform vec2 sheet; // frames, rows\n"
+	"varying vec2 uv;\n"
+	"void main()\n"
+	"{\n"
+	"	float frame = max(floor((time - instance.w) / timing.x), 0.0);\n"
+	"	frame = timing.y > 0.5 ? mod(frame, sheet.x) : min(frame, sheet.x - 1.0);\n"
+	"	vec2 pos = instance.xy + corner * sprite;\n"
+	"	gl_Position = gl_ModelViewProjectionMatrix * vec4(pos, 0.0, 1.0);\n"
+	"	uv = (vec2(frame, instance.z) + corner) / sheet;\n"
+	"}\n";
+
+static const char* batch_fragment_source =
+	"#version 120\n"
+	"uniform sampler2D sampler0;\n"
+	"varying vec2 uv;\n"
+	"void main()\n"
+	"{\n"
+	"	gl_FragColor = texture2D(sampler0, uv);\n"
+	"}\n";
+
+
+/**
+ * @brief Animation batch constructor
+ *
+ * @param f sprite sheet
+ * @param w width of one frame
+ * @param h height of one frame
+ */
+PIXL_AnimationBatch::PIXL_AnimationBatch(const char* f, uint w, uint h): sprite_w(w), sprite_h(h), dirty(false), program(0), corners(0), vbo(0), vbo_size(0)
+{
+	image = IMG_Load(f);
+	frames = image->w/sprite_w;
+	rows = image->h/sprite_h;
+	base_time = PIXL_animations.getTime();
+
+	glGenTextures(1, &texture);
+	PIXL_gl.bindTexture(texture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, image->w, image->h, 0, GL_RGBA, GL_UNSIGNED_INT_8_8_8_8_REV, image->pixels);
+
+	instanced = GLEW_ARB_instanced_arrays && GLEW_ARB_draw_instanced;
+	if(!instanced)
+		return;
+
+	program = PIXL_compileShader(batch_fragment_source, batch_vertex_source);
+	// generic attribute 0 must be an array in the compatibility profile
+	glBindAttribLocation(program, 0, "corner");
+	glLinkProgram(program);
+	corner_attrib = glGetAttribLocation(program, "corner");
+	instance_attrib = glGetAttribLocation(program, "instance");
+	timing_attrib = glGetAttribLocation(program, "timing");
+	time_uniform = glGetUniformLocation(program, "time");
+
+	PIXL_gl.useProgram(program);
+	glUniform1i(glGetUniformLocation(program, "sampler0"), 0);
+	glUniform2f(glGetUniformLocation(program, "sprite"), sprite_w, sprite_h);
+	glUniform2f(glGetUniformLocation(program, "sheet"), frames, rows);
+	PIXL_gl.useProgram(0);
+
+	const GLfloat quad[8] = { 0,0, 0,1, 1,1, 1,0 };
+	glGenBuffers(1, &corners);
+	PIXL_gl.bindBuffer(GL_ARRAY_BUFFER, corners);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(quad), quad, GL_STATIC_DRAW);
+
+	glGenBuffers(1, &vbo);
+}
+
+PIXL_AnimationBatch::~PIXL_AnimationBatch()
+{
+	if(instanced) {
+		PIXL_gl.deleteBuffers(1, &vbo);
+		PIXL_gl.deleteBuffers(1, &corners);
+		PIXL_gl.deleteProgram(program);
+	}
+	PIXL_gl.deleteTextures(1, &texture);
+	SDL_FreeSurface(image);
+}
+
+/**
+ * @brief Add an instance, playing from now
+ *
+ * @param x x-position
+ * @param y y-position
+ * @param row animation (row of the sheet)
+ * @param speed duration of each frame in ms
+ * @param loop repeat, or stop on the last frame
+ * @return index of the instance
+ */
+uint PIXL_AnimationBatch::add(float x, float y, uint row, uint speed, bool loop)
+{
+	Instance i;
+	i.x = x;
+	i.y = y;
+	i.row = row;
+	i.start = PIXL_animations.getTime() - base_time;
+	i.speed = speed ? speed : 1;
+	i.loop = loop;
+	instances.push_back(i);
+	dirty = true;
+
+	return instances.size()-1;
+}
+
+void PIXL_AnimationBatch::remove(uint i)
+{
+	instances[i] = instances.back();
+	instances.pop_back();
+	dirty = true;
+}
+
+void PIXL_AnimationBatch::setPos(uint i, float x, float y)
+{
+	instances[i].x = x;
+	instances[i].y = y;
+	dirty = true;
+}
+
+/**
+ * @brief Start another animation (row) of an instance
+ */
+void PIXL_AnimationBatch::play(uint i, uint row, bool loop)
+{
+	instances[i].row = row;
+	instances[i].loop = loop;
+	instances[i].start = PIXL_animations.getTime() - base_time;
+	dirty = true;
+}
+
+/**
+ * @brief Draw every instance
+ */
+void PIXL_AnimationBatch::draw()
+{
+	if(instances.empty())
+		return;
+
+	PIXL_gl.enable(GL_TEXTURE_2D);
+	PIXL_gl.bindTexture(texture);
+
+	if(!instanced) {
+		drawQuads();
+		return;
+	}
+
+	PIXL_gl.bindBuffer(GL_ARRAY_BUFFER, vbo);
+	if(dirty) {
+		if(instances.size() > vbo_size) {
+			vbo_size = instances.capacity();
+			glBufferData(GL_ARRAY_BUFFER, vbo_size*sizeof(Instance), NULL, GL_DYNAMIC_DRAW);
+		}
+		glBufferSubData(GL_ARRAY_BUFFER, 0, instances.size()*sizeof(Instance), &instances[0]);
+		dirty = false;
+	}
+
+	PIXL_gl.useProgram(program);
+	glUniform1f(time_uniform, PIXL_animations.getTime() - base_time);
+
+	glEnableVertexAttribArray(instance_attrib);
+	glVertexAttribPointer(instance_attrib, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), (GLvoid*)0);
+	glVertexAttribDivisorARB(instance_attrib, 1);
+	glEnableVertexAttribArray(timing_attrib);
+	glVertexAttribPointer(timing_attrib, 2, GL_FLOAT, GL_FALSE, sizeof(Instance), (GLvoid*)(4*sizeof(GLfloat)));
+	glVertexAttribDivisorARB(timing_attrib, 1);
+
+	PIXL_gl.bindBuffer(GL_ARRAY_BUFFER, corners);
+	glEnableVertexAttribArray(corner_attrib);
+	glVertexAttribPointer(corner_attrib, 2, GL_FLOAT, GL_FALSE, 0, (GLvoid*)0);
+
+	glDrawArraysInstancedARB(GL_TRIANGLE_FAN, 0, 4, instances.size());
+
+	// the divisors stick to the attribute indices
+	glVertexAttribDivisorARB(instance_attrib, 0);
+	glVertexAttribDivisorARB(timing_attrib, 0);
+	glDisableVertexAttribArray(instance_attrib);
+	glDisableVertexAttribArray(timing_attrib);
+	glDisableVertexAttribArray(corner_attrib);
+	PIXL_gl.useProgram(0);
+}
+
+/**
+ * @brief Fallback without instancing, same frame selection as the shader
+ */
+void PIXL_AnimationBatch::drawQuads()
+{
+	const float now = PIXL_animations.getTime() - base_time;
+	const float vx = 1.f/frames;
+	const float vy = 1.f/rows;
+	const uint batch = PIXL_stream.getCapacity()/4;
+
+	for(uint first=0; first<instances.size(); first+=batch) {
+		uint n = instances.size()-first < batch ? instances.size()-first : batch;
+		PIXL_Vertex* v = PIXL_stream.map(n*4);
+
+		for(uint k=first; k<first+n; k++, v+=4) {
+			const Instance& i = instances[k];
+			float m = floorf((now - i.start)/i.speed);
+			if(m < 0)
+				m = 0;
+			m = i.loop ? fmodf(m, frames) : (m > frames-1 ? frames-1 : m);
+
+			float s0 = m*vx, t0 = i.row*vy, s1 = s0+vx, t1 = t0+vy;
+			v[0].x = i.x; v[0].y = i.y; v[0].s = s0; v[0].t = t0;
+			v[1].x = i.x; v[1].y = i.y+sprite_h; v[1].s = s0; v[1].t = t1;
+			v[2].x = i.x+sprite_w; v[2].y = i.y+sprite_h; v[2].s = s1; v[2].t = t1;
+			v[3].x = i.x+sprite_w; v[3].y = i.y; v[3].s = s1; v[3].t = t0;
+			for(int j=0; j<4; j++)
+				v[j].color[0] = v[j].color[1] = v[j].color[2] = v[j].color[3] = 255;
+		}
+
+		PIXL_stream.draw(GL_QUADS);
+	}
+}
+
+
+
+/**
+ * @brief Add a clip where every frame lasts the same
+ *
+ * @param row of the sprite sheet
+ * @param frames number of frames
+ * @param ms duration of each frame
+ * @return index of the clip
+ */
+uint PIXL_AnimationClock::addClip(uint row, uint frames, float ms)
+{
+	std::tuple<uint, uint, float> key(row, frames, ms);
+	std::map<std::tuple<uint, uint, float>, uint>::iterator it = uniform_clips.find(key);
+	if(it != uniform_clips.end())
+		return it->second;
+
+	std::vector<float> d(frames ? frames : 1, ms);
+	return uniform_clips[key] = addClip(row, &d[0], frames);
+}
+
+/**
+ * @brief Add a clip with a duration for every frame
+ */
+uint PIXL_AnimationClock::addClip(uint row, const float* d, uint frames)
+{
+	Clip c;
+	c.row = row;
+	c.first = durations.size();
+	c.frames = frames ? frames : 1;
+	for(uint i=0; i<c.frames; i++)
+		durations.push_back(frames && d[i] > 1.f ? d[i] : 1.f); // at least 1 ms, update() loops on them
+	clips.push_back(c);
+
+	return clips.size()-1;
+}
+
+/**
+ * @brief Add an animation playing a clip from its first frame
+ *
+ * @return index of the animation, stable until remove()
+ */
+uint PIXL_AnimationClock::add(uint c, bool loop)
+{
+	uint i;
+	if(!free_slots.empty()) {
+		i = free_slots.back();
+		free_slots.pop_back();
+	} else {
+		i = clip.size();
+		clip.push_back(0);
+		frame.push_back(0);
+		elapsed.push_back(0);
+		speed.push_back(1.f);
+		flags.push_back(0);
+	}
+
+	flags[i] = used;
+	speed[i] = 1.f;
+	play(i, c, loop);
+
+	return i;
+}
+
+void PIXL_AnimationClock::remove(uint i)
+{
+	flags[i] = 0;
+	free_slots.push_back(i);
+}
+
+void PIXL_AnimationClock::play(uint i, uint c, bool loop)
+{
+	clip[i] = c;
+	frame[i] = 0;
+	elapsed[i] = 0;
+	flags[i] = used | playing | (loop ? looping : 0);
+}
+
+/**
+ * @brief Advance every playing animation
+ *
+ * Every frame entered gets its event, also the ones skipped over by a long
+ * dt and a loop coming back to the same frame.
+ *
+ * @param dt elapsed time in ms, scaled by setTimeScale()
+ */
+void PIXL_AnimationClock::update(float dt)
+{
+	events.clear();
+	dt *= time_scale;
+	time += dt;
+
+	const uint n = clip.size();
+	for(uint i=0; i<n; i++) {
+		if(!(flags[i] & playing))
+			continue;
+
+		const Clip& c = clips[clip[i]];
+		const float* d = &durations[c.first];
+		float e = elapsed[i] + dt*speed[i];
+		uint f = frame[i];
+
+		while(e >= d[f]) {
+			e -= d[f];
+			bool finished = false;
+			if(++f == c.frames) {
+				if(flags[i] & looping) {
+					f = 0;
+				} else {
+					f = c.frames-1;
+					e = 0;
+					flags[i] &= ~playing;
+					finished = true;
+				}
+			}
+			PIXL_AnimationEvent ev = { i, f, finished };
+			events.push_back(ev);
+			if(finished)
+				break;
+		}
+
+		elapsed[i] = e;
+		frame[i] = f;
+	}
+}
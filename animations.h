@@ -0,0 +1,166 @@
+/* 
+ * Copyright (C) 2012 - Brian Gomes Bascoy
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ * 
+ */
+
+#ifndef _PIXL_ANIMATIONS_H_
+#define _PIXL_ANIMATIONS_H_
+
+#include <vector>
+#include <map>
+#include <tuple>
+#include <GL/glew.h>
+#include <SDL/SDL.h>
+
+#include "config.h"
+#include "app.h"
+#include "glstate.h"
+#include "stream.h"
+
+/**
+ * @brief Frame change reported by PIXL_AnimationClock::update(), one per
+ * frame entered
+ */
+typedef struct {
+	uint animation;
+	uint frame;
+	bool finished; // reached the last frame of a clip without loop
+} PIXL_AnimationEvent;
+
+
+/**
+ * @brief Advances every animation once per tick
+ *
+ * Clips are a row of a sprite sheet with a duration for every frame. The
+ * state of the animations (clip, frame, time in the frame, speed, flags)
+ * is kept in parallel arrays and update() walks them once per frame with
+ * the time of the fixed ticks of PIXL_App, so animations follow the game
+ * clock: they can be paused, slowed down or sped up and don't depend on
+ * when they are drawn. getTime() is that clock, scaled by setTimeScale(),
+ * PIXL_AnimationBatch animates with it.
+ *
+ * Clips with the same row, frames and frame duration are shared, so
+ * animations created and destroyed all the time don't add clips.
+ *
+ * The frame changes of the last update() are in getEvents(), in order and
+ * none skipped however long the update was, the sprite
+ * batchers read getFrame() and getRow() (see PIXL_Animation). PIXL_App
+ * updates the global PIXL_animations.
+ */
+class PIXL_AnimationClock {
+	public:
+		PIXL_AnimationClock(): time_scale(1.f), time(0) {}
+		uint addClip(uint row, uint frames, float ms);
+		uint addClip(uint row, const float* durations, uint frames);
+		uint add(uint c, bool loop=true);
+		void remove(uint i);
+		void play(uint i, uint c, bool loop);
+		void pause(uint i) { flags[i] &= ~playing; }
+		void resume(uint i) { flags[i] |= playing; }
+		void setSpeed(uint i, float s) { speed[i] = s; }
+		void setTimeScale(float s) { time_scale = s; }
+		void update(float dt);
+		uint getFrame(uint i) { return frame[i]; }
+		uint getRow(uint i) { return clips[clip[i]].row; }
+		bool isPlaying(uint i) { return flags[i] & playing; }
+		const std::vector<PIXL_AnimationEvent>& getEvents() { return events; }
+		uint getCount() { return clip.size() - free_slots.size(); }
+		double getTime() { return time; }
+	private:
+		enum { playing = 1, looping = 2, used = 4 };
+		typedef struct {
+			uint row;
+			uint first; // in durations
+			uint frames;
+		} Clip;
+
+		std::vector<Clip> clips;
+		std::vector<float> durations; // ms of every frame of every clip
+		// one entry per animation
+		std::vector<uint> clip;
+		std::vector<uint> frame;
+		std::vector<float> elapsed; // ms in the current frame
+		std::vector<float> speed;
+		std::vector<unsigned char> flags;
+		std::vector<uint> free_slots;
+		std::vector<PIXL_AnimationEvent> events;
+		std::map<std::tuple<uint, uint, float>, uint> uniform_clips; // (row, frames, ms) -> clip
+		float time_scale;
+		double time; // ms, scaled
+};
+
+
+/**
+ * @brief Many instances of the same sprite sheet drawn with one call
+ *
+ * Like PIXL_Animation, every row of the sheet is an animation and every
+ * column a frame, but each instance only stores its position, row, start
+ * time, speed and loop flag in an instance buffer. The vertex shader
+ * picks the frame from the current time, so a crowd costs one draw and
+ * no per frame uploads unless instances move.
+ *
+ * Needs ARB_instanced_arrays and ARB_draw_instanced, without them the
+ * frames are computed on the CPU and drawn as one batch of quads.
+ *
+ * @note remove() moves the last instance to the removed index
+ */
+class PIXL_AnimationBatch {
+	public:
+		PIXL_AnimationBatch(const char* f, uint w, uint h);
+		virtual ~PIXL_AnimationBatch();
+		uint add(float x, float y, uint row, uint speed, bool loop=true);
+		void remove(uint i);
+		void setPos(uint i, float x, float y);
+		void play(uint i, uint row, bool loop);
+		void draw();
+		uint getCount() { return instances.size(); }
+		bool isInstanced() { return instanced; }
+	private:
+		typedef struct {
+			GLfloat x;
+			GLfloat y;
+			GLfloat row;
+			GLfloat start; // ms since base_time
+			GLfloat speed; // ms per frame
+			GLfloat loop;
+		} Instance;
+
+		void drawQuads();
+
+		SDL_Surface* image;
+		GLuint texture;
+		uint sprite_w; // width of one single sprite
+		uint sprite_h; // height of one single sprite
+		uint frames; // columns of the sheet
+		uint rows;
+		double base_time; // PIXL_animations.getTime() when created, keeps the float times small
+		std::vector<Instance> instances;
+		bool instanced;
+		bool dirty; // instances changed since the last upload
+		GLuint program;
+		GLuint corners; // the 4 corners of a quad
+		GLuint vbo; // instances
+		uint vbo_size; // in instances
+		GLint corner_attrib;
+		GLint instance_attrib;
+		GLint timing_attrib;
+		GLint time_uniform;
+};
+
+extern PIXL_AnimationClock PIXL_animations;
+
+#endif // _PIXL_ANIMATIONS_H_
+
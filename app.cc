@@ -17,6 +17,9 @@
  */
 
 #include "app.h"
+#include "animations.h"
+#include "arena.h"
+#include "camera.h"
 
 /*
  * Instantiating the ugly global...
@@ -25,6 +28,34 @@
 PIXL_Config PIXL_config;
 
 
+/**
+ * @brief Where the virtual resolution ends up in the window
+ *
+ * Integer upscaling uses the biggest whole factor that fits, unless the
+ * window is smaller than the virtual resolution. Both keep the aspect
+ * ratio and center the image.
+ */
+void PIXL_Config::getViewport(int* x, int* y, int* vw, int* vh) const
+{
+	float factor = std::min((float)window_width/width, (float)window_height/height);
+	if(upscaling == integer && factor >= 1.f)
+		factor = floorf(factor);
+
+	*vw = (int)(width*factor + 0.5f);
+	*vh = (int)(height*factor + 0.5f);
+	*x = ((int)window_width - *vw)/2;
+	*y = ((int)window_height - *vh)/2;
+}
+
+void PIXL_bindScreen()
+{
+	int x, y, w, h;
+	PIXL_config.getViewport(&x, &y, &w, &h);
+	PIXL_gl.bindFramebuffer(0);
+	PIXL_gl.viewport(x, y, w, h);
+}
+
+
 /**
  * @brief Timer constructor
  *
@@ -94,7 +125,40 @@ bool PIXL_bbc(SDL_Rect b1, SDL_Rect b2)
 }
 
 
+/*
+ * Programs with "w" and "h" uniforms, updated when the resolution changes
+ *
+ */
+static std::vector<GLuint> sized_shaders;
+
+static void updateShaders()
+{
+	for(uint i=0; i<sized_shaders.size(); i++) {
+		GLuint program = sized_shaders[i];
+		if(!glIsProgram(program)) {
+			// deleted by its owner
+			sized_shaders[i--] = sized_shaders.back();
+			sized_shaders.pop_back();
+			continue;
+		}
+		PIXL_gl.useProgram(program);
+		glUniform1f(glGetUniformLocation(program, "w"), PIXL_config.getRenderWidth());
+		glUniform1f(glGetUniformLocation(program, "h"), PIXL_config.getRenderHeight());
+	}
+	PIXL_gl.useProgram(0);
+}
+
+
 GLuint PIXL_loadShader(const char* filename)
+{
+	const char *source = PIXL_LoadTextFile(filename);
+	GLuint program = PIXL_compileShader(source);
+	free((void*)source);
+
+	return program;
+}
+
+GLuint PIXL_compileShader(const char* source, const char* vertex)
 {
 	GLuint FragmentShader;
 	GLint linked;
@@ -104,7 +168,7 @@ GLuint PIXL_loadShader(const char* filename)
 	FragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
 	program = glCreateProgram();
 
-	const GLchar *fragmentSrc = PIXL_LoadTextFile(filename);
+	const GLchar *fragmentSrc = source;
 
 	glShaderSource(FragmentShader, 1, &fragmentSrc, NULL);
 	glCompileShader(FragmentShader);
@@ -123,11 +187,31 @@ GLuint PIXL_loadShader(const char* filename)
 	}
 
 	glAttachShader(program, FragmentShader);
+
+	if(vertex) {
+		GLuint VertexShader = glCreateShader(GL_VERTEX_SHADER);
+		glShaderSource(VertexShader, 1, &vertex, NULL);
+		glCompileShader(VertexShader);
+		glGetShaderiv(VertexShader, GL_COMPILE_STATUS, &compiled);
+
+		if (!compiled) {
+			GLint length;
+			GLchar* log;
+			glGetShaderiv(VertexShader, GL_INFO_LOG_LENGTH, &length);
+
+			log = (GLchar*) malloc(length);
+			glGetShaderInfoLog(VertexShader, length, &length, log);
+			fprintf(stderr, "\nVertex compile log\n------------------\n%s\n", log);
+		}
+
+		glAttachShader(program, VertexShader);
+	}
+
 	glLinkProgram(program);
 	glGetProgramiv(program, GL_LINK_STATUS, &linked);
 
 	if(linked){
-		glUseProgram(program);
+		PIXL_gl.useProgram(program);
 	} else {
 		GLint length;
 		GLchar* log;
@@ -143,10 +227,12 @@ GLuint PIXL_loadShader(const char* filename)
 
 	GLfloat width = glGetUniformLocation(program, "w");
 	GLfloat height = glGetUniformLocation(program, "h");
-	glUniform1f(width, *PIXL_config.w);
-	glUniform1f(height, *PIXL_config.h);
+	glUniform1f(width, PIXL_config.getRenderWidth());
+	glUniform1f(height, PIXL_config.getRenderHeight());
+	if(width >= 0 || height >= 0)
+		sized_shaders.push_back(program);
 
-	glActiveTexture(GL_TEXTURE0);
+	PIXL_gl.activeTexture(GL_TEXTURE0);
 
 	GLenum errCode = glGetError();
 	const GLubyte *errString;
@@ -155,7 +241,7 @@ GLuint PIXL_loadShader(const char* filename)
 		fprintf(stderr, "OpenGL Error: %s\n", errString);
 	}
 
-	glUseProgram(0);
+	PIXL_gl.useProgram(0);
 
 	return program;
 }
@@ -163,6 +249,9 @@ GLuint PIXL_loadShader(const char* filename)
 
 PIXL_App::PIXL_App()
 {
+	// tiny for the demo, games using PIXL_sweep can go up to 1000/30.f
+	timestep = 1.f / 100.0f;
+
 	/*
 	 * SDL INITIALIZATION
 	 * 
@@ -177,14 +266,17 @@ PIXL_App::PIXL_App()
 	SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1);
 	SDL_GL_SetAttribute(SDL_GL_SWAP_CONTROL, 1);
 
-	if(!(screen = SDL_SetVideoMode(*PIXL_config.w, *PIXL_config.h, 32, SDL_OPENGL))){
+	window_w = PIXL_config.getWindowWidth();
+	window_h = PIXL_config.getWindowHeight();
+	if(!(screen = SDL_SetVideoMode(window_w, window_h, 32, SDL_OPENGL|SDL_RESIZABLE))){
 		printf("Unable to set video mode: %s\n", SDL_GetError());
 		//return 1;
 	}
 
 	SDL_GL_SetAttribute(SDL_GL_MULTISAMPLEBUFFERS, 1);
 	SDL_GL_SetAttribute(SDL_GL_MULTISAMPLESAMPLES, 4);
-	glEnable(GL_MULTISAMPLE);
+	PIXL_gl.invalidate(); // fresh context
+	PIXL_gl.enable(GL_MULTISAMPLE);
 
 	SDL_WM_SetCaption("PIXL v" VERSION, NULL);
 
@@ -226,9 +318,10 @@ PIXL_App::PIXL_App()
 
 	glClearColor(0, 0, 0, 1);
 
-	glDisable(GL_DEPTH_TEST);
+	PIXL_gl.disable(GL_DEPTH_TEST);
+	PIXL_gl.activeTexture(GL_TEXTURE0);
 
-	glViewport(0, 0, *PIXL_config.w, *PIXL_config.h);
+	PIXL_bindScreen();
 
 	glMatrixMode(GL_PROJECTION);
 	glLoadIdentity();
@@ -238,15 +331,68 @@ PIXL_App::PIXL_App()
 	glMatrixMode(GL_MODELVIEW);
 	glLoadIdentity();
 
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	PIXL_gl.enable(GL_BLEND);
+	PIXL_gl.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+	/*
+	 * JOB SYSTEM
+	 *
+	 */
+
+	jobs = new PIXL_JobSystem();
+	printf("Worker threads: %u\n", jobs->getThreadCount());
+
+	resolution = NULL;
+	generation = PIXL_config.getGeneration();
+}
+
+/**
+ * @brief Apply a change of resolution, window size or render scale
+ *
+ * FBOs and layers reallocate by themselves the next time they are used,
+ * here only the window, the projection and the "w" and "h" uniforms of
+ * the shaders are updated before calling resized().
+ */
+void PIXL_App::applyResolution()
+{
+	generation = PIXL_config.getGeneration();
+
+	if(window_w != PIXL_config.getWindowWidth() || window_h != PIXL_config.getWindowHeight()) {
+		window_w = PIXL_config.getWindowWidth();
+		window_h = PIXL_config.getWindowHeight();
+		// keeps the GL context with X11, other SDL 1.2 backends may lose it
+		if(!(screen = SDL_SetVideoMode(window_w, window_h, 32, SDL_OPENGL|SDL_RESIZABLE)))
+			printf("Unable to set video mode: %s\n", SDL_GetError());
+		PIXL_gl.invalidate();
+		PIXL_stream.release(); // created again on the next draw
+	}
+
+	PIXL_Camera::reset(); // the projection, cameras use the new size when applied
+
+	PIXL_bindScreen();
+	updateShaders();
+
+	resized();
+}
+
+/**
+ * @brief Scale the internal resolution to render frames in time
+ *
+ * @param ms frame time budget, 0 to go back to a fixed scale
+ * @param min_scale lowest scale of the virtual resolution
+ * @param max_scale highest scale
+ */
+void PIXL_App::setFrameBudget(double ms, float min_scale, float max_scale)
+{
+	delete resolution;
+	resolution = ms > 0 ? new PIXL_DynamicResolution(ms, min_scale, max_scale) : NULL;
 }
 
 void PIXL_App::run()
 {
 	/*** game time stuff HACK ***/
 	double t = 0.f;
-	const double dt = 1.f / 100.0f;
+	const double dt = timestep;
 
 	double currentTime = SDL_GetTicks(); //GetTicks es uint32
 	double accumulator = 0.f;
@@ -254,6 +400,9 @@ void PIXL_App::run()
 	/*** MAIN LOOP ***/
 	while(state.get() != state.quit)
 	{
+		if(generation != PIXL_config.getGeneration())
+			applyResolution();
+
 		double newTime = SDL_GetTicks();
 		double frameTime = newTime - currentTime;
 		currentTime = newTime;
@@ -261,17 +410,36 @@ void PIXL_App::run()
 		accumulator += frameTime;
 
 		/*** UPDATE ***/
+		double ticked = 0; // by this frame, the animations advance once for all of it
 		while(accumulator >= dt)
 		{
 			update();
 
 			accumulator -= dt;
 			t += dt;
+			ticked += dt;
 		}
+		if(ticked > 0)
+			PIXL_animations.update(ticked);
 
 		/*** RENDER ***/
+		// the whole window, render() only draws inside the letterbox
+		PIXL_gl.bindFramebuffer(0);
+		PIXL_gl.viewport(0, 0, window_w, window_h);
+		glClear(GL_COLOR_BUFFER_BIT);
+		PIXL_bindScreen();
+
+		if(resolution)
+			resolution->begin();
 		render();
+		// before the swap, it may wait for the vsync
+		if(resolution)
+			resolution->end();
 		SDL_GL_SwapBuffers();
+		PIXL_gl.newFrame();
+		PIXL_stream.endFrame();
+		PIXL_Camera::newFrame();
+		PIXL_FrameArena::resetAll();
 
 		/*** INPUT HANDLING ***/
 		input();
@@ -280,13 +448,97 @@ void PIXL_App::run()
 
 void PIXL_App::input()
 {
-	SDL_PollEvent(&event);
-	if(event.type == SDL_KEYDOWN) {
-		switch(event.key.keysym.sym) {
-			case SDLK_ESCAPE:
-				state.set(state.quit);
-				break;
+	while(SDL_PollEvent(&event)) {
+		if(event.type == SDL_VIDEORESIZE)
+			PIXL_config.setWindowSize(event.resize.w, event.resize.h);
+		if(event.type == SDL_KEYDOWN) {
+			switch(event.key.keysym.sym) {
+				case SDLK_ESCAPE:
+					state.set(state.quit);
+					break;
+			}
 		}
 	}
 }
 
+
+
+PIXL_DynamicResolution::PIXL_DynamicResolution(double budget_ms, float min, float max):
+	frame(0), start(0), budget(budget_ms), average(0), min_scale(min), max_scale(max), cooldown(0)
+{
+	timer = GLEW_ARB_timer_query;
+	if(timer)
+		glGenQueries(queries, query);
+}
+
+PIXL_DynamicResolution::~PIXL_DynamicResolution()
+{
+	if(timer)
+		glDeleteQueries(queries, query);
+}
+
+/**
+ * @brief Start timing a frame
+ */
+void PIXL_DynamicResolution::begin()
+{
+	if(timer)
+		glBeginQuery(GL_TIME_ELAPSED, query[frame % queries]);
+	else
+		start = SDL_GetTicks();
+}
+
+/**
+ * @brief Stop timing a frame and adjust the scale with the oldest result
+ */
+void PIXL_DynamicResolution::end()
+{
+	if(!timer) {
+		adjust(SDL_GetTicks() - start);
+		return;
+	}
+
+	glEndQuery(GL_TIME_ELAPSED);
+	frame++;
+	if(frame < queries)
+		return;
+
+	// the query of queries-1 frames ago, the GPU is done with it by now
+	GLuint oldest = query[frame % queries];
+	GLint available = 0;
+	glGetQueryObjectiv(oldest, GL_QUERY_RESULT_AVAILABLE, &available);
+	if(available) {
+		GLuint64 ns;
+		glGetQueryObjectui64v(oldest, GL_QUERY_RESULT, &ns);
+		adjust(ns / 1000000.0);
+	}
+}
+
+void PIXL_DynamicResolution::adjust(double ms)
+{
+	average = average ? average*0.9 + ms*0.1 : ms;
+
+	if(cooldown) {
+		cooldown--;
+		return;
+	}
+
+	const float step = 1.f/16;
+	float scale = PIXL_config.getScale();
+	float target = scale;
+
+	if(average > budget) {
+		// the cost goes with the area, aim right under the budget
+		target = scale * sqrtf(budget*0.9/average);
+		target = floorf(target/step)*step;
+	} else if(average < budget*0.7) {
+		target = scale + step;
+	}
+
+	target = std::max(min_scale, std::min(max_scale, target));
+	if(target != scale) {
+		PIXL_config.setScale(target);
+		average = 0;
+		cooldown = 30;
+	}
+}
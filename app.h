@@ -16,13 +16,18 @@
  * 
  */
 
+#ifndef _PIXL_APP_H_
+#define _PIXL_APP_H_
+
 #define VERSION "0.1"
 
 #include <iostream>
 #include <fstream>
 #include <sstream>
 #include <string>
+#include <vector>
 #include <cmath>
+#include <algorithm>
 #include <assert.h>
 #include <GL/glew.h>
 #include <GL/glxew.h>
@@ -36,7 +41,10 @@
 #include <librsvg/rsvg.h>
 
 #include "config.h"
+#include "glstate.h"
 #include "filesystem.h"
+#include "jobs.h"
+#include "stream.h"
 
 typedef unsigned int uint;
 
@@ -71,22 +79,66 @@ class PIXL_Timer {
 };
 
 
+/**
+ * @brief Dynamic resolution, keeps the frame time under a budget
+ *
+ * Times the GPU work of every frame (ARB_timer_query, read a few frames
+ * later so it never stalls, or the CPU time of render() and the buffer
+ * swap without it) and scales the internal resolution of PIXL_config:
+ * down as soon as the average goes over the budget, up one step at a time
+ * when there is room again. The scale moves in 1/16 steps with a cooldown
+ * so the FBOs are not reallocated every frame.
+ */
+class PIXL_DynamicResolution {
+	public:
+		PIXL_DynamicResolution(double budget_ms, float min=0.5f, float max=1.f);
+		~PIXL_DynamicResolution();
+		void begin();
+		void end();
+		double getFrameTime() { return average; }
+	private:
+		void adjust(double ms);
+		enum { queries = 4 };
+		GLuint query[queries];
+		uint frame;
+		bool timer; // GPU timer queries available
+		double start;
+		double budget; // ms
+		double average; // ms, smoothed
+		float min_scale;
+		float max_scale;
+		uint cooldown; // frames left before touching the scale again
+};
+
+
 /**
  * @brief Application abstract class
  */
 class PIXL_App {
 	public:
 		PIXL_App();
-		~PIXL_App() { SDL_Quit(); }
+		~PIXL_App() { delete resolution; delete jobs; PIXL_stream.release(); SDL_Quit(); }
 		//virtual ~PIXL_App();
 		void run();
+		void setTimestep(double ms) { timestep=ms; }
+		double getTimestep() { return timestep; }
+		PIXL_JobSystem* getJobs() { return jobs; }
+		void setFrameBudget(double ms, float min_scale=0.5f, float max_scale=1.f);
 		virtual void update() = 0;
 		virtual void render() = 0;
+		virtual void resized() {} // after a change of PIXL_config sizes
 		void input();
 	private:
+		void applyResolution();
 		SDL_Surface *screen;
 		SDL_Event event;
 		PIXL_State state;
+		double timestep; // fixed update interval in ms
+		PIXL_JobSystem* jobs; // workers for update() and render() to fan out
+		PIXL_DynamicResolution* resolution; // NULL unless there is a frame budget
+		uint generation; // of PIXL_config last applied
+		uint window_w;
+		uint window_h;
 };
 
 
@@ -98,6 +150,15 @@ class PIXL_App {
 GLuint PIXL_loadShader(const char* filename);
 
 
+/**
+ * @brief Same as PIXL_loadShader but from the source code
+ *
+ * @param source fragment shader
+ * @param vertex vertex shader, the fixed pipeline if NULL
+ */
+GLuint PIXL_compileShader(const char* source, const char* vertex=NULL);
+
+
 /**
  * @brief Simple bounding box collision detection
  *
@@ -108,3 +169,4 @@ GLuint PIXL_loadShader(const char* filename);
  */
 bool PIXL_bbc(SDL_Rect b1, SDL_Rect b2);
 
+#endif // _PIXL_APP_H_
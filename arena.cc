@@ -0,0 +1,150 @@
+/* 
+ * Copyright (C) 2012 - Brian Gomes Bascoy
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ * 
+ */
+
+
+#include "arena.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <mutex>
+
+/*
+ * Arenas of every thread, for resetAll()
+ *
+ */
+static std::mutex arenas_mutex;
+static std::vector<PIXL_FrameArena*> arenas;
+
+
+PIXL_FrameArena::PIXL_FrameArena(size_t bytes): head(0), used(0), capacity(bytes), high_water(0)
+{
+	grow(bytes);
+
+	std::lock_guard<std::mutex> lock(arenas_mutex);
+	arenas.push_back(this);
+}
+
+PIXL_FrameArena::~PIXL_FrameArena()
+{
+	for(uint i=0; i<blocks.size(); i++)
+		free(blocks[i]);
+
+	std::lock_guard<std::mutex> lock(arenas_mutex);
+	arenas.erase(std::find(arenas.begin(), arenas.end(), this));
+}
+
+/**
+ * @brief Arena of the calling thread, created on the first call
+ */
+PIXL_FrameArena& PIXL_FrameArena::get()
+{
+	static thread_local PIXL_FrameArena arena;
+	return arena;
+}
+
+void PIXL_FrameArena::grow(size_t bytes)
+{
+	char* block = (char*)malloc(bytes);
+	if(!block) {
+		printf("Frame arena: can't allocate %lu bytes\n", (unsigned long)bytes);
+		abort();
+	}
+	blocks.push_back(block);
+	sizes.push_back(bytes);
+	head = 0;
+}
+
+/**
+ * @brief Memory valid until the end of the frame
+ *
+ * @param align power of two
+ */
+void* PIXL_FrameArena::allocate(size_t bytes, size_t align)
+{
+	uintptr_t base = (uintptr_t)blocks.back();
+	size_t start = ((base + head + align-1) & ~(uintptr_t)(align-1)) - base;
+
+	if(start + bytes > sizes.back()) {
+		// a bigger block for this frame, reset() merges them
+		grow(std::max(capacity, bytes + align));
+		base = (uintptr_t)blocks.back();
+		start = ((base + align-1) & ~(uintptr_t)(align-1)) - base;
+	}
+
+	used += start - head + bytes;
+	head = start + bytes;
+	return blocks.back() + start;
+}
+
+/**
+ * @brief Copy a string to the arena, 0 terminated
+ */
+char* PIXL_FrameArena::copy(const char* s, size_t length)
+{
+	char* c = (char*)allocate(length+1, 1);
+	memcpy(c, s, length);
+	c[length] = 0;
+	return c;
+}
+
+/**
+ * @brief Forget everything allocated, at the end of a frame
+ */
+void PIXL_FrameArena::reset()
+{
+	if(used > high_water)
+		high_water = used;
+
+	if(blocks.size() > 1) {
+		// the frame didn't fit, one block for all of it from now on
+		for(uint i=0; i<blocks.size(); i++)
+			free(blocks[i]);
+		blocks.clear();
+		sizes.clear();
+		capacity = high_water + high_water/4;
+		grow(capacity);
+	}
+
+	head = 0;
+	used = 0;
+}
+
+/**
+ * @brief Reset the arenas of every thread, nothing may be using them
+ */
+void PIXL_FrameArena::resetAll()
+{
+	std::lock_guard<std::mutex> lock(arenas_mutex);
+	for(uint i=0; i<arenas.size(); i++)
+		arenas[i]->reset();
+}
+
+/**
+ * @brief Sum of the high water marks of every thread
+ */
+size_t PIXL_FrameArena::getTotalHighWater()
+{
+	std::lock_guard<std::mutex> lock(arenas_mutex);
+	size_t total = 0;
+	for(uint i=0; i<arenas.size(); i++)
+		total += arenas[i]->high_water;
+	return total;
+}
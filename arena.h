@@ -0,0 +1,92 @@
+/* 
+ * Copyright (C) 2012 - Brian Gomes Bascoy
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ * 
+ */
+
+
+#ifndef _PIXL_ARENA_H_
+#define _PIXL_ARENA_H_
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+#include "config.h"
+
+/**
+ * @brief Bump allocator for data that only lives during one frame
+ *
+ * Every thread has its own arena (get()), so allocating takes no lock.
+ * Memory is never freed one by one: PIXL_App calls resetAll() after each
+ * frame and everything allocated in it is gone. When a frame needs more
+ * than the block, more blocks are added and reset() merges them into one
+ * as big as the high water mark, so in steady state nothing comes from
+ * malloc. Don't keep frame data across frames, and don't let jobs run
+ * over the end of the frame.
+ *
+ * PIXL_FrameAllocator lets STL containers use it:
+ *
+ *   PIXL_FrameVector<int> visible;
+ *   PIXL_FrameString text;
+ */
+class PIXL_FrameArena {
+	public:
+		PIXL_FrameArena(size_t bytes=256*1024);
+		~PIXL_FrameArena();
+		void* allocate(size_t bytes, size_t align=sizeof(void*)*2);
+		char* copy(const char* s, size_t length);
+		void reset();
+		size_t getUsed() { return used; }
+		size_t getHighWater() { return high_water; }
+		size_t getCapacity() { return capacity; }
+		static PIXL_FrameArena& get();
+		static void resetAll();
+		static size_t getTotalHighWater();
+	private:
+		PIXL_FrameArena(const PIXL_FrameArena&);
+		PIXL_FrameArena& operator=(const PIXL_FrameArena&);
+		void grow(size_t bytes);
+
+		std::vector<char*> blocks; // the current one is the last
+		std::vector<size_t> sizes;
+		size_t head; // in the current block
+		size_t used; // this frame, in every block
+		size_t capacity; // of every block
+		size_t high_water; // most used in a frame
+};
+
+
+/**
+ * @brief STL allocator on a PIXL_FrameArena, the calling thread's by default
+ */
+template<class T> class PIXL_FrameAllocator {
+	public:
+		typedef T value_type;
+		PIXL_FrameAllocator(): arena(&PIXL_FrameArena::get()) {}
+		PIXL_FrameAllocator(PIXL_FrameArena* a): arena(a) {}
+		template<class U> PIXL_FrameAllocator(const PIXL_FrameAllocator<U>& other): arena(other.arena) {}
+		T* allocate(size_t n) { return (T*)arena->allocate(n*sizeof(T), alignof(T)); }
+		void deallocate(T*, size_t) {}
+		template<class U> bool operator==(const PIXL_FrameAllocator<U>& other) const { return arena == other.arena; }
+		template<class U> bool operator!=(const PIXL_FrameAllocator<U>& other) const { return arena != other.arena; }
+
+		PIXL_FrameArena* arena;
+};
+
+template<class T> using PIXL_FrameVector = std::vector<T, PIXL_FrameAllocator<T> >;
+typedef std::basic_string<char, std::char_traits<char>, PIXL_FrameAllocator<char> > PIXL_FrameString;
+
+#endif // _PIXL_ARENA_H_
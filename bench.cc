@@ -0,0 +1,364 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+
+#include "animations.h"
+#include "app.h"
+#include "ecs.h"
+#include "effects.h"
+#include "fonts.h"
+#include "graphics.h"
+#include "pool.h"
+#include "rendergraph.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Helpers ////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+static double now_ms()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec*1000.0 + ts.tv_nsec/1000000.0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ECS: iterating 1M entities /////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+struct Position { float x, y; };
+struct Velocity { float x, y; };
+
+void benchECS()
+{
+	const uint entities = 1000000;
+	const uint runs = 20;
+	PIXL_World world;
+
+	double start = now_ms();
+	for(uint i=0; i<entities; i++) {
+		PIXL_Entity e = world.create();
+		Position p = { (float)i, 0 };
+		world.add<Position>(e, p);
+		// only half of them move, so the query has to skip some
+		if(i%2 == 0) {
+			Velocity v = { 1, 0.5f };
+			world.add<Velocity>(e, v);
+		}
+	}
+	printf("ecs: create %u entities: %.2f ms\n", entities, now_ms()-start);
+
+	start = now_ms();
+	for(uint r=0; r<runs; r++) {
+		world.each<Position>([](PIXL_Entity, Position& p) {
+			p.y += 1;
+		});
+	}
+	double elapsed = (now_ms()-start)/runs;
+	printf("ecs: each<Position> over %u: %.2f ms (%.2f ns/entity)\n", entities, elapsed, elapsed*1000000.0/entities);
+
+	start = now_ms();
+	for(uint r=0; r<runs; r++) {
+		world.each<Velocity, Position>([](PIXL_Entity, Velocity& v, Position& p) {
+			p.x += v.x;
+			p.y += v.y;
+		});
+	}
+	elapsed = (now_ms()-start)/runs;
+	printf("ecs: each<Velocity, Position> over %u: %.2f ms (%.2f ns/entity)\n", world.pool<Velocity>().size(), elapsed, elapsed*1000000.0/world.pool<Velocity>().size());
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Fonts: creating text labels at startup /////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief What every PIXL_Text used to do on its own
+ */
+static PangoLayout* queryLayout(const char* font)
+{
+	FcBlanks* blanks = FcBlanksCreate();
+	int count = 0;
+	FcConfigAppFontAddFile(FcConfigGetCurrent(), (const FcChar8*)font);
+	FcPattern* pattern = FcFreeTypeQuery((const FcChar8*)font, 0, blanks, &count);
+	PangoFontDescription* description = pango_fc_font_description_from_pattern(pattern, 0);
+	pango_font_description_set_size(description, 12*PANGO_SCALE);
+	PangoContext* context = pango_font_map_create_context(pango_cairo_font_map_get_default());
+	PangoLayout* layout = pango_layout_new(context);
+	pango_layout_set_font_description(layout, description);
+	g_object_unref(context);
+	pango_font_description_free(description);
+	FcPatternDestroy(pattern);
+	FcBlanksDestroy(blanks);
+	return layout;
+}
+
+void benchFonts()
+{
+	const char* font = "fonts/ProggyTiny.ttf";
+	const uint labels = 64;
+	std::vector<PangoLayout*> layouts;
+
+	// untimed, so the fontconfig and pango caches are warm for both ways
+	g_object_unref(queryLayout(font));
+
+	double start = now_ms();
+	for(uint i=0; i<labels; i++)
+		layouts.push_back(queryLayout(font));
+	printf("fonts: %u labels, query per label: %.2f ms\n", labels, now_ms()-start);
+
+	for(uint i=0; i<layouts.size(); i++)
+		g_object_unref(layouts[i]);
+	layouts.clear();
+
+	start = now_ms();
+	for(uint i=0; i<labels; i++)
+		layouts.push_back(pango_layout_new(PIXL_fonts.getContext(font, 12)));
+	printf("fonts: %u labels, shared registry: %.2f ms (%u file loads)\n", labels, now_ms()-start, PIXL_fonts.getFilesLoaded());
+
+	for(uint i=0; i<layouts.size(); i++)
+		g_object_unref(layouts[i]);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Pool: bullets spawned and despawned every frame ////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+struct Bullet {
+	float x, y, vx, vy;
+	int life; // frames
+	Bullet(float px, float py, int l): x(px), y(py), vx(1), vy(0.5f), life(l) {}
+};
+
+void benchPool()
+{
+	const uint bullets = 50000;
+	const uint frames = 200;
+	const uint spawns = 1000; // per frame, they live 50 frames
+
+	// the usual way: new, a list of pointers, delete
+	std::vector<Bullet*> heap;
+	double start = now_ms();
+	for(uint f=0; f<frames; f++) {
+		for(uint i=0; i<spawns; i++)
+			heap.push_back(new Bullet(i, f, 50));
+		for(uint i=0; i<heap.size(); ) {
+			Bullet* b = heap[i];
+			b->x += b->vx;
+			b->y += b->vy;
+			if(--b->life > 0) {
+				i++;
+			} else {
+				delete b;
+				heap[i] = heap.back();
+				heap.pop_back();
+			}
+		}
+	}
+	printf("pool: new/delete, %lu alive: %.3f ms/frame\n", (unsigned long)heap.size(), (now_ms()-start)/frames);
+	for(uint i=0; i<heap.size(); i++)
+		delete heap[i];
+
+	PIXL_ObjectPool<Bullet> pool(bullets);
+	start = now_ms();
+	for(uint f=0; f<frames; f++) {
+		for(uint i=0; i<spawns; i++)
+			pool.spawn(i, f, 50);
+		for(uint i=0; i<pool.getCount(); ) {
+			Bullet& b = pool[i];
+			b.x += b.vx;
+			b.y += b.vy;
+			if(--b.life > 0)
+				i++;
+			else
+				pool.despawn(pool.getHandle(i));
+		}
+	}
+	printf("pool: PIXL_ObjectPool, %u alive (%.0f%% full): %.3f ms/frame\n", pool.getCount(), pool.getOccupancy()*100, (now_ms()-start)/frames);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Blur: dual filter against the two pass gaussian ////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+// PIXL_App opens the window and the GL context, we drive the frames ourselves
+class BenchApp: public PIXL_App {
+	public:
+		void update() {}
+		void render() {}
+};
+
+static double timeGraph(PIXL_RenderGraph* graph, uint frames)
+{
+	graph->execute(); // warm up: allocate the targets
+	glFinish();
+
+	double start = now_ms();
+	for(uint i=0; i<frames; i++)
+		graph->execute();
+	glFinish();
+	return (now_ms()-start)/frames;
+}
+
+void benchBlur()
+{
+	const uint frames = 200;
+	BenchApp app;
+	PIXL_FBO scene;
+	PIXL_RenderGraph graph;
+
+	graph.setTexture("scene", scene.getTexture());
+	graph.addPass(PIXL_loadShader("gbh.glsl"), "scene", "blur");
+	graph.addPass(PIXL_loadShader("gbv.glsl"), "blur", "screen");
+	printf("blur: gaussian (gbh + gbv): %.3f ms/frame\n", timeGraph(&graph, frames));
+
+	const uint qualities[] = { PIXL_Blur::low, PIXL_Blur::medium, PIXL_Blur::high };
+	for(uint i=0; i<3; i++) {
+		PIXL_Blur blur(qualities[i]);
+		graph.clear();
+		graph.setTexture("scene", scene.getTexture());
+		blur.addTo(&graph, "scene", "screen");
+		printf("blur: dual filter, %u levels: %.3f ms/frame\n", qualities[i], timeGraph(&graph, frames));
+	}
+
+	PIXL_Blur bloom;
+	bloom.setBloom(0.8f, 1.f);
+	graph.clear();
+	graph.setTexture("scene", scene.getTexture());
+	bloom.addTo(&graph, "scene", "screen");
+	printf("blur: bloom, %u levels: %.3f ms/frame\n", (uint)PIXL_Blur::medium, timeGraph(&graph, frames));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Crowd: 5000 animated sprites ///////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+void benchCrowd()
+{
+	const uint sprites = 5000;
+	const uint frames = 100;
+	BenchApp app;
+	std::vector<PIXL_Animation*> animations;
+	PIXL_AnimationBatch batch("cats.png", 23, 23);
+
+	for(uint i=0; i<sprites; i++) {
+		animations.push_back(new PIXL_Animation("cats.png", 23, 23, 100 + i%50));
+		animations.back()->play(i%4, true);
+		batch.add(i%80*8, i/80*7, i%4, 100 + i%50);
+	}
+
+	glFinish();
+	double start = now_ms();
+	for(uint f=0; f<frames; f++)
+		for(uint i=0; i<sprites; i++)
+			animations[i]->draw(i%80*8, i/80*7);
+	glFinish();
+	printf("crowd: %u PIXL_Animation: %.3f ms/frame\n", sprites, (now_ms()-start)/frames);
+
+	batch.draw(); // first upload of the instances
+	glFinish();
+	start = now_ms();
+	for(uint f=0; f<frames; f++)
+		batch.draw();
+	glFinish();
+	printf("crowd: %u in a PIXL_AnimationBatch (%s): %.3f ms/frame\n", sprites, batch.isInstanced() ? "instanced" : "quads", (now_ms()-start)/frames);
+
+	for(uint i=0; i<sprites; i++)
+		delete animations[i];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Tiles: a sparse overlay, full layer against a tiled one ////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+void benchTiles()
+{
+	const uint frames = 200;
+	BenchApp app;
+	PIXL_Layer layer;
+	PIXL_Text text(&layer, "fonts/ProggyTiny.ttf", 12, 10, 10);
+	char label[32];
+
+	glFinish();
+	double start = now_ms();
+	for(uint f=0; f<frames; f++) {
+		snprintf(label, sizeof(label), "FPS: %u", f);
+		layer.clear();
+		text.print(label);
+		layer.draw();
+	}
+	glFinish();
+	printf("tiles: full layer, %d KB: %.3f ms/frame\n", layer.getWidth()*layer.getHeight()*4/1024, (now_ms()-start)/frames);
+
+	PIXL_TiledLayer tiled(128, app.getJobs());
+	PangoLayout* layout = pango_layout_new(PIXL_fonts.getContext("fonts/ProggyTiny.ttf", 12));
+	SDL_Rect area = { 0, 0, 120, 40 };
+
+	glFinish();
+	start = now_ms();
+	for(uint f=0; f<frames; f++) {
+		snprintf(label, sizeof(label), "FPS: %u", f);
+		pango_layout_set_text(layout, label, -1);
+		tiled.clear();
+		tiled.paint(area, [layout](cairo_t* cr) {
+			std::lock_guard<std::recursive_mutex> lock(PIXL_fonts.getMutex());
+			cairo_move_to(cr, 10, 10);
+			cairo_set_source_rgba(cr, 1, 1, 1, 1);
+			pango_cairo_show_layout(cr, layout);
+		});
+		tiled.render();
+		tiled.draw();
+	}
+	glFinish();
+	printf("tiles: tiled layer, %u tiles, %u KB: %.3f ms/frame\n", tiled.getTileCount(), (uint)(tiled.getBytes()/1024), (now_ms()-start)/frames);
+
+	// white text hides swapped channels, a tile painted red once must read
+	// back red
+	PIXL_TiledLayer colour(128);
+	SDL_Rect corner = { 0, 0, 16, 16 };
+	colour.paint(corner, [](cairo_t* cr) {
+		cairo_set_source_rgba(cr, 1, 0, 0, 1);
+		cairo_paint(cr);
+	});
+	colour.render();
+	glClearColor(0, 0, 0, 1);
+	glClear(GL_COLOR_BUFFER_BIT);
+	colour.draw();
+	unsigned char pixel[4];
+	glReadPixels(8, layer.getHeight()-8, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, pixel);
+	printf("tiles: red tile reads back as %u,%u,%u: %s\n", pixel[0], pixel[1], pixel[2], pixel[0] > 200 && pixel[2] < 50 ? "ok" : "WRONG");
+
+	g_object_unref(layout);
+}
+
+
+/**
+ * Without arguments only the benchmarks that need no window run,
+ * "./pixl_bench blur", "./pixl_bench crowd" and "./pixl_bench tiles" open
+ * one for the GPU ones.
+ */
+int main(int argc, const char *argv[])
+{
+	if(argc > 1 && !strcmp(argv[1], "blur")) {
+		benchBlur();
+		return 0;
+	}
+	if(argc > 1 && !strcmp(argv[1], "crowd")) {
+		benchCrowd();
+		return 0;
+	}
+	if(argc > 1 && !strcmp(argv[1], "tiles")) {
+		benchTiles();
+		return 0;
+	}
+
+	benchECS();
+	benchPool();
+	benchFonts();
+
+	return 0;
+}
+
@@ -0,0 +1,177 @@
+/* 
+ * Copyright (C) 2012 - Brian Gomes Bascoy
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ * 
+ */
+
+
+#include "camera.h"
+
+#include <math.h>
+#include <stddef.h>
+
+PIXL_Camera* PIXL_Camera::current = NULL;
+uint PIXL_Camera::frame = 0;
+
+
+PIXL_Camera::PIXL_Camera(): zoom(1.f), rotation(0), drawn(0), culled(0), last_drawn(0), last_culled(0), counted_frame(frame)
+{
+	pos_x = *PIXL_config.w * 0.5f;
+	pos_y = *PIXL_config.h * 0.5f;
+	bounds_key[0] = -1; // compute on the first use
+}
+
+PIXL_Camera::~PIXL_Camera()
+{
+	if(current == this)
+		reset();
+}
+
+/**
+ * @brief Load the view as the projection and make this camera current
+ *
+ * World point p ends at R*zoom*(p - pos) + (w/2, h/2) on the screen,
+ * premultiplied by the glOrtho(0, w, h, 0, -1, 1) of PIXL_App.
+ */
+void PIXL_Camera::apply()
+{
+	const float w = *PIXL_config.w;
+	const float h = *PIXL_config.h;
+	const float r = rotation * M_PI / 180.f;
+	const float c = cosf(r);
+	const float s = sinf(r);
+
+	const float a = 2*zoom*c/w;
+	const float b = -2*zoom*s/w;
+	const float d = -2*zoom*s/h;
+	const float e = -2*zoom*c/h;
+
+	GLfloat m[16] = {
+		a, d, 0, 0,
+		b, e, 0, 0,
+		0, 0, -1, 0,
+		-(a*pos_x + b*pos_y), -(d*pos_x + e*pos_y), 0, 1
+	};
+
+	glMatrixMode(GL_PROJECTION);
+	glLoadMatrixf(m);
+	glMatrixMode(GL_MODELVIEW);
+
+	current = this;
+}
+
+/**
+ * @brief Back to screen coordinates, with no current camera
+ */
+void PIXL_Camera::reset()
+{
+	glMatrixMode(GL_PROJECTION);
+	glLoadIdentity();
+	glOrtho(0, *PIXL_config.w, *PIXL_config.h, 0, -1, 1);
+	glMatrixMode(GL_MODELVIEW);
+
+	current = NULL;
+}
+
+/**
+ * @brief Bounding box of the visible area, only when zoom, rotation or resolution change
+ */
+void PIXL_Camera::update()
+{
+	const float w = *PIXL_config.w;
+	if(bounds_key[0] == zoom && bounds_key[1] == rotation && bounds_key[2] == w && bounds_h == *PIXL_config.h)
+		return;
+	bounds_key[0] = zoom;
+	bounds_key[1] = rotation;
+	bounds_key[2] = w;
+	bounds_h = *PIXL_config.h;
+
+	const float r = rotation * M_PI / 180.f;
+	const float c = fabsf(cosf(r));
+	const float s = fabsf(sinf(r));
+	const float hw = w * 0.5f / zoom;
+	const float hh = bounds_h * 0.5f / zoom;
+
+	// half extents relative to the position
+	bounds[0] = c*hw + s*hh;
+	bounds[1] = s*hw + c*hh;
+}
+
+bool PIXL_Camera::isVisible(float x0, float y0, float x1, float y1)
+{
+	update();
+
+	return x1 >= pos_x - bounds[0] && x0 <= pos_x + bounds[0] && y1 >= pos_y - bounds[1] && y0 <= pos_y + bounds[1];
+}
+
+/**
+ * @brief Test a bounding box and count it
+ *
+ * @return true if it is outside the view and must not be drawn
+ */
+bool PIXL_Camera::cull(float x0, float y0, float x1, float y1)
+{
+	roll();
+
+	if(isVisible(x0, y0, x1, y1)) {
+		drawn++;
+		return false;
+	}
+
+	culled++;
+	return true;
+}
+
+/**
+ * @brief Range of tiles of a map that can be seen, to draw only those
+ *
+ * @param tile_w size of a tile in pixels
+ * @param tile_h
+ * @param map_w size of the map in tiles
+ * @param map_h
+ * @param x0 first visible column
+ * @param y0 first visible row
+ * @param x1 one past the last visible column, equal to x0 if none
+ * @param y1 one past the last visible row
+ */
+void PIXL_Camera::getVisibleTiles(uint tile_w, uint tile_h, uint map_w, uint map_h, uint* x0, uint* y0, uint* x1, uint* y1)
+{
+	update();
+
+	float l = floorf((pos_x - bounds[0]) / tile_w);
+	float t = floorf((pos_y - bounds[1]) / tile_h);
+	float r = floorf((pos_x + bounds[0]) / tile_w) + 1;
+	float b = floorf((pos_y + bounds[1]) / tile_h) + 1;
+
+	*x0 = l < 0 ? 0 : (l > map_w ? map_w : l);
+	*y0 = t < 0 ? 0 : (t > map_h ? map_h : t);
+	*x1 = r < *x0 ? *x0 : (r > map_w ? map_w : r);
+	*y1 = b < *y0 ? *y0 : (b > map_h ? map_h : b);
+}
+
+/**
+ * @brief Keep the counts of the last frame when a new one started
+ */
+void PIXL_Camera::roll()
+{
+	if(counted_frame == frame)
+		return;
+
+	// a camera not used in the last frame counts nothing
+	last_drawn = counted_frame+1 == frame ? drawn : 0;
+	last_culled = counted_frame+1 == frame ? culled : 0;
+	drawn = culled = 0;
+	counted_frame = frame;
+}
@@ -0,0 +1,95 @@
+/* 
+ * Copyright (C) 2012 - Brian Gomes Bascoy
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ * 
+ */
+
+
+#ifndef _PIXL_CAMERA_H_
+#define _PIXL_CAMERA_H_
+
+#include <GL/glew.h>
+
+#include "config.h"
+
+/**
+ * @brief View of the world with position, zoom and rotation
+ *
+ * The position is the point of the world at the centre of the screen,
+ * the default camera (centre of the virtual resolution, zoom 1, no
+ * rotation) shows the same as the plain screen projection. apply() loads
+ * the whole view as one projection matrix and makes the camera current,
+ * reset() goes back to screen coordinates.
+ *
+ * Draws in world coordinates ask cull() first. It tests the bounding box
+ * against the visible area (the bounding box of the rotated view) and
+ * counts what is drawn and culled, getDrawn() and getCulled() are the
+ * counts of the last frame. PIXL_RenderQueue::setCamera() culls queued
+ * quads when they are submitted and applies the camera when flushing.
+ */
+class PIXL_Camera {
+	public:
+		PIXL_Camera();
+		virtual ~PIXL_Camera();
+		void setPos(float x, float y) { pos_x = x; pos_y = y; }
+		void move(float dx, float dy) { pos_x += dx; pos_y += dy; }
+		void setZoom(float z) { zoom = z > 0.001f ? z : 0.001f; }
+		void setRotation(float degrees) { rotation = degrees; }
+		float getX() { return pos_x; }
+		float getY() { return pos_y; }
+		float getZoom() { return zoom; }
+		float getRotation() { return rotation; }
+		void apply();
+		bool isVisible(float x0, float y0, float x1, float y1);
+		bool cull(float x0, float y0, float x1, float y1);
+		void getVisibleTiles(uint tile_w, uint tile_h, uint map_w, uint map_h, uint* x0, uint* y0, uint* x1, uint* y1);
+		uint getDrawn() { roll(); return last_drawn; }
+		uint getCulled() { roll(); return last_culled; }
+		static PIXL_Camera* getCurrent() { return current; }
+		static void reset();
+		static void newFrame() { frame++; }
+	private:
+		void update();
+		void roll();
+		float pos_x;
+		float pos_y;
+		float zoom;
+		float rotation;
+		// visible area, see update()
+		float bounds[4];
+		float bounds_key[3]; // zoom, rotation and width the bounds were computed for
+		uint bounds_h;
+		uint drawn;
+		uint culled;
+		uint last_drawn; // in the last frame
+		uint last_culled;
+		uint counted_frame;
+
+		static PIXL_Camera* current;
+		static uint frame;
+};
+
+/**
+ * @brief Count a draw and tell if it has to be skipped
+ *
+ * Draws with no current camera are never culled.
+ */
+inline bool PIXL_cull(float x0, float y0, float x1, float y1)
+{
+	PIXL_Camera* c = PIXL_Camera::getCurrent();
+	return c && c->cull(x0, y0, x1, y1);
+}
+
+#endif // _PIXL_CAMERA_H_
@@ -0,0 +1,387 @@
+/* 
+ * Copyright (C) 2012 - Brian Gomes Bascoy
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ * 
+ */
+
+#include "collision.h"
+
+#include <cmath>
+#include <cfloat>
+
+/**
+ * @brief Solidity bitmap constructor, every tile starts as not solid
+ *
+ * @param tiles amount of tiles in the tileset (tileset_size.w*tileset_size.h)
+ */
+PIXL_TileSolidity::PIXL_TileSolidity(uint tiles): bits((tiles>>5)+1, 0), count(tiles)
+{
+}
+
+/**
+ * @brief Mark a tile of the tileset as solid (or not)
+ *
+ * @param gid tile number starting from 1, as stored in PIXL_T_map::tile
+ * @param solid new value
+ */
+void PIXL_TileSolidity::set(int gid, bool solid)
+{
+	if(gid <= 0 || (uint)gid > count)
+		return;
+
+	if(solid)
+		bits[gid>>5] |= 1u << (gid&31);
+	else
+		bits[gid>>5] &= ~(1u << (gid&31));
+}
+
+
+/**
+ * @brief Tile collider constructor
+ *
+ * @param m the map, its tile array is read directly (not copied)
+ * @param s which tiles of the tileset are solid
+ * @param ox x-position where the map is drawn
+ * @param oy y-position where the map is drawn
+ */
+PIXL_TileCollider::PIXL_TileCollider(const PIXL_T_map* m, const PIXL_TileSolidity* s, int ox, int oy): map(m), solidity(s), origin_x(ox), origin_y(oy)
+{
+}
+
+/**
+ * @brief Check a single cell
+ *
+ * @param tx tile column
+ * @param ty tile row
+ *
+ * @return true if the cell is inside the map and its tile is solid
+ */
+bool PIXL_TileCollider::isSolid(int tx, int ty) const
+{
+	if(tx < 0 || ty < 0 || tx >= (int)map->size.w || ty >= (int)map->size.h)
+		return false;
+
+	uint i = ty*map->size.w + tx;
+	if(i >= map->tile.size())
+		return false;
+
+	return solidity->isSolid(map->tile[i]);
+}
+
+bool PIXL_TileCollider::isSolidArea(int tx0, int ty0, int tx1, int ty1) const
+{
+	if(tx0 < 0) tx0 = 0;
+	if(ty0 < 0) ty0 = 0;
+	if(tx1 >= (int)map->size.w) tx1 = map->size.w-1;
+	if(ty1 >= (int)map->size.h) ty1 = map->size.h-1;
+
+	for(int ty=ty0; ty<=ty1; ty++)
+		for(int tx=tx0; tx<=tx1; tx++)
+			if(isSolid(tx, ty))
+				return true;
+
+	return false;
+}
+
+/**
+ * @brief Box against solid tiles, only the cells under the box are read
+ *
+ * @return true if the box overlaps any solid tile
+ */
+bool PIXL_TileCollider::overlaps(PIXL_AABB box) const
+{
+	const float tw = map->tile_size.w;
+	const float th = map->tile_size.h;
+
+	return isSolidArea((int)floorf((box.x - origin_x)/tw),
+	                   (int)floorf((box.y - origin_y)/th),
+	                   (int)ceilf((box.x + box.w - origin_x)/tw) - 1,
+	                   (int)ceilf((box.y + box.h - origin_y)/th) - 1);
+}
+
+bool PIXL_TileCollider::overlaps(SDL_Rect box) const
+{
+	PIXL_AABB b = { (float)box.x, (float)box.y, (float)box.w, (float)box.h };
+	return overlaps(b);
+}
+
+/**
+ * @brief Swept movement of a box through the map
+ *
+ * The box is moved along x and then along y, every column (or row) crossed
+ * is checked so fast boxes don't tunnel through thin walls. When a solid
+ * tile is found the box is left touching it.
+ *
+ * @param box the box, it is assumed not to be overlapping solid tiles already
+ * @param dx displacement in x
+ * @param dy displacement in y
+ * @param hit_x set to true if the horizontal movement was blocked
+ * @param hit_y set to true if the vertical movement was blocked
+ *
+ * @return the box at its new position
+ */
+PIXL_AABB PIXL_TileCollider::move(PIXL_AABB box, float dx, float dy, bool* hit_x, bool* hit_y) const
+{
+	const float tw = map->tile_size.w;
+	const float th = map->tile_size.h;
+	bool hx = false;
+	bool hy = false;
+
+	if(dx != 0) {
+		int r0 = (int)floorf((box.y - origin_y)/th);
+		int r1 = (int)ceilf((box.y + box.h - origin_y)/th) - 1;
+
+		if(dx > 0) {
+			int c0 = (int)ceilf((box.x + box.w - origin_x)/tw);
+			int c1 = (int)ceilf((box.x + box.w + dx - origin_x)/tw) - 1;
+			if(c0 < 0) c0 = 0;
+			if(c1 >= (int)map->size.w) c1 = map->size.w-1;
+			for(int c=c0; c<=c1 && !hx; c++) {
+				if(isSolidArea(c, r0, c, r1)) {
+					box.x = origin_x + c*tw - box.w;
+					hx = true;
+				}
+			}
+		} else {
+			int c0 = (int)floorf((box.x - origin_x)/tw) - 1;
+			int c1 = (int)floorf((box.x + dx - origin_x)/tw);
+			if(c0 >= (int)map->size.w) c0 = map->size.w-1;
+			if(c1 < 0) c1 = 0;
+			for(int c=c0; c>=c1 && !hx; c--) {
+				if(isSolidArea(c, r0, c, r1)) {
+					box.x = origin_x + (c+1)*tw;
+					hx = true;
+				}
+			}
+		}
+
+		if(!hx)
+			box.x += dx;
+	}
+
+	if(dy != 0) {
+		int c0 = (int)floorf((box.x - origin_x)/tw);
+		int c1 = (int)ceilf((box.x + box.w - origin_x)/tw) - 1;
+
+		if(dy > 0) {
+			int r0 = (int)ceilf((box.y + box.h - origin_y)/th);
+			int r1 = (int)ceilf((box.y + box.h + dy - origin_y)/th) - 1;
+			if(r0 < 0) r0 = 0;
+			if(r1 >= (int)map->size.h) r1 = map->size.h-1;
+			for(int r=r0; r<=r1 && !hy; r++) {
+				if(isSolidArea(c0, r, c1, r)) {
+					box.y = origin_y + r*th - box.h;
+					hy = true;
+				}
+			}
+		} else {
+			int r0 = (int)floorf((box.y - origin_y)/th) - 1;
+			int r1 = (int)floorf((box.y + dy - origin_y)/th);
+			if(r0 >= (int)map->size.h) r0 = map->size.h-1;
+			if(r1 < 0) r1 = 0;
+			for(int r=r0; r>=r1 && !hy; r--) {
+				if(isSolidArea(c0, r, c1, r)) {
+					box.y = origin_y + (r+1)*th;
+					hy = true;
+				}
+			}
+		}
+
+		if(!hy)
+			box.y += dy;
+	}
+
+	if(hit_x)
+		*hit_x = hx;
+	if(hit_y)
+		*hit_y = hy;
+
+	return box;
+}
+
+/**
+ * @brief DDA raycast (Amanatides & Woo), only the cells along the ray are visited
+ *
+ * @param x0 ray origin
+ * @param y0 ray origin
+ * @param x1 ray end
+ * @param y1 ray end
+ * @param hit filled with the first solid cell found, if any
+ *
+ * @return true if the segment hits a solid tile
+ */
+bool PIXL_TileCollider::raycast(float x0, float y0, float x1, float y1, PIXL_RayHit* hit) const
+{
+	const float tw = map->tile_size.w;
+	const float th = map->tile_size.h;
+	const float dx = x1 - x0;
+	const float dy = y1 - y0;
+
+	// position in tile units
+	const float fx = (x0 - origin_x)/tw;
+	const float fy = (y0 - origin_y)/th;
+	int cx = (int)floorf(fx);
+	int cy = (int)floorf(fy);
+
+	const int step_x = dx > 0 ? 1 : (dx < 0 ? -1 : 0);
+	const int step_y = dy > 0 ? 1 : (dy < 0 ? -1 : 0);
+
+	// t needed to cross a whole cell, and t of the next cell boundary
+	const float delta_x = step_x ? tw/fabsf(dx) : FLT_MAX;
+	const float delta_y = step_y ? th/fabsf(dy) : FLT_MAX;
+	float max_x = step_x > 0 ? (cx + 1 - fx)*delta_x : (step_x < 0 ? (fx - cx)*delta_x : FLT_MAX);
+	float max_y = step_y > 0 ? (cy + 1 - fy)*delta_y : (step_y < 0 ? (fy - cy)*delta_y : FLT_MAX);
+
+	float t = 0;
+	int nx = 0;
+	int ny = 0;
+	const int w = map->size.w;
+	const int h = map->size.h;
+
+	for(;;) {
+		if(isSolid(cx, cy)) {
+			if(hit) {
+				hit->tx = cx;
+				hit->ty = cy;
+				hit->t = t;
+				hit->x = x0 + dx*t;
+				hit->y = y0 + dy*t;
+				hit->nx = nx;
+				hit->ny = ny;
+			}
+			return true;
+		}
+
+		// we left the map and we are moving away from it
+		if((cx < 0 && step_x <= 0) || (cx >= w && step_x >= 0) ||
+		   (cy < 0 && step_y <= 0) || (cy >= h && step_y >= 0))
+			return false;
+
+		if(max_x < max_y) {
+			t = max_x;
+			max_x += delta_x;
+			cx += step_x;
+			nx = -step_x;
+			ny = 0;
+		} else {
+			t = max_y;
+			max_y += delta_y;
+			cy += step_y;
+			nx = 0;
+			ny = -step_y;
+		}
+
+		if(t > 1)
+			return false;
+	}
+}
+
+
+bool PIXL_sweep(PIXL_AABB a, float dx, float dy, PIXL_AABB b, PIXL_SweepHit* hit)
+{
+	float entry_x, exit_x, entry_y, exit_y;
+
+	if(dx == 0) {
+		if(a.x + a.w <= b.x || a.x >= b.x + b.w)
+			return false;
+		entry_x = -FLT_MAX;
+		exit_x = FLT_MAX;
+	} else if(dx > 0) {
+		entry_x = (b.x - (a.x + a.w))/dx;
+		exit_x = (b.x + b.w - a.x)/dx;
+	} else {
+		entry_x = (b.x + b.w - a.x)/dx;
+		exit_x = (b.x - (a.x + a.w))/dx;
+	}
+
+	if(dy == 0) {
+		if(a.y + a.h <= b.y || a.y >= b.y + b.h)
+			return false;
+		entry_y = -FLT_MAX;
+		exit_y = FLT_MAX;
+	} else if(dy > 0) {
+		entry_y = (b.y - (a.y + a.h))/dy;
+		exit_y = (b.y + b.h - a.y)/dy;
+	} else {
+		entry_y = (b.y + b.h - a.y)/dy;
+		exit_y = (b.y - (a.y + a.h))/dy;
+	}
+
+	float entry = entry_x > entry_y ? entry_x : entry_y;
+	float exit = exit_x < exit_y ? exit_x : exit_y;
+
+	// entry < 0 means they were already overlapping, that is PIXL_bbc's job
+	if(entry > exit || entry < 0 || entry > 1)
+		return false;
+
+	if(hit) {
+		hit->t = entry;
+		hit->index = -1;
+		if(entry_x > entry_y) {
+			hit->nx = dx > 0 ? -1 : 1;
+			hit->ny = 0;
+		} else {
+			hit->nx = 0;
+			hit->ny = dy > 0 ? -1 : 1;
+		}
+	}
+
+	return true;
+}
+
+PIXL_AABB PIXL_moveAndSlide(PIXL_AABB box, float dx, float dy, const PIXL_AABB* obstacles, uint n, PIXL_SweepHit* hit)
+{
+	if(hit)
+		hit->index = -1;
+
+	// after each hit the remaining displacement loses its component along
+	// the normal, so the second iteration either slides freely or hits the
+	// other axis and stops: two iterations are enough, even for a corner
+	for(int i=0; i<2 && (dx != 0 || dy != 0); i++) {
+		PIXL_SweepHit nearest;
+		nearest.t = 2;
+		nearest.index = -1;
+
+		for(uint j=0; j<n; j++) {
+			PIXL_SweepHit h;
+			if(PIXL_sweep(box, dx, dy, obstacles[j], &h) && h.t < nearest.t) {
+				nearest = h;
+				nearest.index = j;
+			}
+		}
+
+		if(nearest.index < 0) {
+			box.x += dx;
+			box.y += dy;
+			break;
+		}
+
+		if(hit && hit->index < 0)
+			*hit = nearest;
+
+		box.x += dx*nearest.t;
+		box.y += dy*nearest.t;
+		dx *= 1 - nearest.t;
+		dy *= 1 - nearest.t;
+
+		if(nearest.nx != 0)
+			dx = 0;
+		else
+			dy = 0;
+	}
+
+	return box;
+}
+
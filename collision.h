@@ -0,0 +1,139 @@
+/* 
+ * Copyright (C) 2012 - Brian Gomes Bascoy
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ * 
+ */
+
+#ifndef _PIXL_COLLISION_H_
+#define _PIXL_COLLISION_H_
+
+#include <vector>
+#include <stdint.h>
+#include <SDL/SDL.h>
+
+#include "config.h"
+#include "map.h"
+
+/**
+ * @brief Axis aligned box with subpixel precision
+ */
+typedef struct {
+	float x;
+	float y;
+	float w;
+	float h;
+} PIXL_AABB;
+
+
+/**
+ * @brief Result of a raycast against a tile map
+ */
+typedef struct {
+	int tx; // hit tile column
+	int ty; // hit tile row
+	float x; // hit point in pixels
+	float y;
+	float t; // fraction of the ray travelled, between 0 and 1
+	int nx; // normal of the face that was hit (0 if the ray started inside a solid tile)
+	int ny;
+} PIXL_RayHit;
+
+
+/**
+ * @brief Result of a swept box query
+ */
+typedef struct {
+	float t; // fraction of the displacement travelled before touching, between 0 and 1
+	float nx; // normal of the face that was hit
+	float ny;
+	int index; // obstacle that was hit (PIXL_moveAndSlide only, -1 if none)
+} PIXL_SweepHit;
+
+
+/**
+ * @brief Swept (continuous) box collision, time of impact
+ *
+ * Unlike PIXL_bbc this can't miss thin or fast moving boxes, whatever the
+ * timestep is. If both boxes move use the displacement of a relative to b.
+ *
+ * @param a the moving box
+ * @param dx displacement of a during this step
+ * @param dy displacement of a during this step
+ * @param b the static box
+ * @param hit filled with the time of impact and normal, if any
+ *
+ * @return true if a touches b before the end of the displacement
+ */
+bool PIXL_sweep(PIXL_AABB a, float dx, float dy, PIXL_AABB b, PIXL_SweepHit* hit=NULL);
+
+
+/**
+ * @brief Move a box against a set of static boxes sliding along what it hits
+ *
+ * @param box the moving box
+ * @param dx displacement for this step
+ * @param dy displacement for this step
+ * @param obstacles boxes to collide with
+ * @param n amount of obstacles
+ * @param hit filled with the first hit of the step (hit->index is -1 if none)
+ *
+ * @return the box at its new position
+ */
+PIXL_AABB PIXL_moveAndSlide(PIXL_AABB box, float dx, float dy, const PIXL_AABB* obstacles, uint n, PIXL_SweepHit* hit=NULL);
+
+
+/**
+ * @brief One bit per tile of a tileset telling if that tile is solid
+ */
+class PIXL_TileSolidity {
+	public:
+		PIXL_TileSolidity(uint tiles);
+		void set(int gid, bool solid=true);
+		bool isSolid(int gid) const
+		{
+			// gid 0 is an empty cell
+			return gid > 0 && (uint)gid <= count && (bits[gid>>5] >> (gid&31)) & 1;
+		}
+	private:
+		std::vector<uint32_t> bits;
+		uint count;
+};
+
+
+/**
+ * @brief Collision queries that read the tile array of a map directly
+ *
+ * @note Everything is in pixels, (ox, oy) being where the map is drawn.
+ * Cells outside of the map are never solid.
+ */
+class PIXL_TileCollider {
+	public:
+		PIXL_TileCollider(const PIXL_T_map* m, const PIXL_TileSolidity* s, int ox=0, int oy=0);
+		void setOrigin(int ox, int oy) { origin_x=ox; origin_y=oy; }
+		bool isSolid(int tx, int ty) const;
+		bool overlaps(PIXL_AABB box) const;
+		bool overlaps(SDL_Rect box) const;
+		PIXL_AABB move(PIXL_AABB box, float dx, float dy, bool* hit_x=NULL, bool* hit_y=NULL) const;
+		bool raycast(float x0, float y0, float x1, float y1, PIXL_RayHit* hit=NULL) const;
+	private:
+		bool isSolidArea(int tx0, int ty0, int tx1, int ty1) const;
+		const PIXL_T_map* map;
+		const PIXL_TileSolidity* solidity;
+		int origin_x;
+		int origin_y;
+};
+
+#endif // _PIXL_COLLISION_H_
+
@@ -23,19 +23,50 @@ typedef unsigned int uint;
  
 /**
  * @brief General configuration object
+ *
+ * w and h are the virtual resolution, the coordinates the game draws in.
+ * The scene is rendered at getScale() times that size (see PIXL_FBO) and
+ * upscaled to the window, by an integer factor or filtered to fit.
+ *
+ * Any of the sizes can change at run time: objects depending on them
+ * compare getGeneration() with the one they were allocated for and
+ * reallocate lazily, PIXL_App updates the window and the shaders and
+ * calls PIXL_App::resized().
  */
 class PIXL_Config {
 	public:
-		PIXL_Config(uint initial_width = 640, uint initial_height = 480): w(&width), h(&height), width(initial_width), height(initial_height) {}
-		//void setResolution(uint new_width, uint new_height) { width=new_width; height=new_height; } // Pandora's Box
+		enum { integer, filtered }; // upscaling
+		PIXL_Config(uint initial_width = 640, uint initial_height = 480): w(&width), h(&height), width(initial_width), height(initial_height), window_width(initial_width), window_height(initial_height), scale(1.f), upscaling(filtered), generation(0) {}
+		void setResolution(uint new_width, uint new_height) { if(new_width != width || new_height != height) { width=new_width; height=new_height; generation++; } }
+		void setWindowSize(uint new_width, uint new_height) { if(new_width != window_width || new_height != window_height) { window_width=new_width; window_height=new_height; generation++; } }
+		uint getWindowWidth() const { return window_width; }
+		uint getWindowHeight() const { return window_height; }
+		void setScale(float s) { s = s < 0.125f ? 0.125f : (s > 2.f ? 2.f : s); if(s != scale) { scale = s; generation++; } }
+		float getScale() const { return scale; }
+		uint getRenderWidth() const { return (uint)(width*scale + 0.5f); }
+		uint getRenderHeight() const { return (uint)(height*scale + 0.5f); }
+		void setUpscaling(int mode) { upscaling=mode; }
+		int getUpscaling() const { return upscaling; }
+		void getViewport(int* x, int* y, int* vw, int* vh) const;
+		uint getGeneration() const { return generation; }
 		const uint *const w;
 		const uint *const h;
 	private:
 		uint width;
 		uint height;
+		uint window_width;
+		uint window_height;
+		float scale; // internal resolution over the virtual one
+		int upscaling;
+		uint generation; // bumped by every size that changes
 };
 
 extern PIXL_Config PIXL_config;
 
+/**
+ * @brief Render to the window, letterboxed to the virtual resolution
+ */
+void PIXL_bindScreen();
+
 #endif // _PIXL_CONFIG_H_
 
@@ -0,0 +1,76 @@
+/* 
+ * Copyright (C) 2012 - Brian Gomes Bascoy
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ * 
+ */
+
+#include "ecs.h"
+
+PIXL_Entity PIXL_EntityManager::create()
+{
+	PIXL_Entity e;
+
+	if(!free_indices.empty()) {
+		e.index = free_indices.back();
+		free_indices.pop_back();
+	} else {
+		e.index = generations.size();
+		generations.push_back(0);
+	}
+	e.generation = generations[e.index];
+
+	return e;
+}
+
+/**
+ * @brief Destroy an entity, old handles to it become stale
+ */
+void PIXL_EntityManager::destroy(PIXL_Entity e)
+{
+	if(!isAlive(e))
+		return;
+
+	generations[e.index]++;
+	free_indices.push_back(e.index);
+}
+
+
+PIXL_World::~PIXL_World()
+{
+	for(uint i=0; i<pools.size(); i++)
+		delete pools[i];
+}
+
+/**
+ * @brief Destroy an entity and all its components
+ */
+void PIXL_World::destroy(PIXL_Entity e)
+{
+	if(!isAlive(e))
+		return;
+
+	for(uint i=0; i<pools.size(); i++)
+		if(pools[i])
+			pools[i]->remove(e.index);
+
+	entities.destroy(e);
+}
+
+uint PIXL_World::nextTypeId()
+{
+	static uint next = 0;
+	return next++;
+}
+
@@ -0,0 +1,243 @@
+/* 
+ * Copyright (C) 2012 - Brian Gomes Bascoy
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ * 
+ */
+
+#ifndef _PIXL_ECS_H_
+#define _PIXL_ECS_H_
+
+#include <vector>
+#include <tuple>
+#include <type_traits>
+#include <stddef.h>
+#include <stdint.h>
+#include <assert.h>
+
+#include "config.h"
+
+/**
+ * @brief Entity handle, the generation tells apart reused slots
+ */
+struct PIXL_Entity {
+	uint32_t index;
+	uint32_t generation;
+	bool operator==(const PIXL_Entity& e) const { return index==e.index && generation==e.generation; }
+	bool operator!=(const PIXL_Entity& e) const { return !(*this==e); }
+};
+
+
+/**
+ * @brief Creates and recycles entity handles
+ */
+class PIXL_EntityManager {
+	public:
+		PIXL_Entity create();
+		void destroy(PIXL_Entity e);
+		bool isAlive(PIXL_Entity e) const { return e.index < generations.size() && generations[e.index] == e.generation; }
+		uint count() const { return generations.size() - free_indices.size(); }
+	private:
+		std::vector<uint32_t> generations;
+		std::vector<uint32_t> free_indices;
+};
+
+
+/**
+ * @brief Type erased part of a component pool
+ */
+class PIXL_BaseComponentPool {
+	public:
+		virtual ~PIXL_BaseComponentPool() {}
+		virtual void remove(uint32_t index) = 0;
+		virtual bool contains(uint32_t index) const = 0;
+};
+
+
+/**
+ * @brief Sparse set of components of one type
+ *
+ * Components live packed in a dense array (one array per component type) so
+ * iterating a pool is a linear walk through memory. Removing swaps the last
+ * component into the hole.
+ */
+template<typename T>
+class PIXL_ComponentPool: public PIXL_BaseComponentPool {
+	public:
+		enum { none = 0xFFFFFFFFu };
+
+		T& add(PIXL_Entity e, const T& component)
+		{
+			if(e.index >= sparse.size())
+				sparse.resize(e.index+1, none);
+
+			if(sparse[e.index] != none) {
+				dense[sparse[e.index]] = component;
+				return dense[sparse[e.index]];
+			}
+
+			sparse[e.index] = dense.size();
+			dense.push_back(component);
+			owners.push_back(e);
+			return dense.back();
+		}
+
+		void remove(uint32_t index)
+		{
+			if(!contains(index))
+				return;
+
+			uint32_t hole = sparse[index];
+			uint32_t last = dense.size()-1;
+			if(hole != last) {
+				dense[hole] = dense[last];
+				owners[hole] = owners[last];
+				sparse[owners[hole].index] = hole;
+			}
+			dense.pop_back();
+			owners.pop_back();
+			sparse[index] = none;
+		}
+
+		bool contains(uint32_t index) const { return index < sparse.size() && sparse[index] != none; }
+
+		T& at(uint32_t index)
+		{
+			assert(contains(index));
+			return dense[sparse[index]];
+		}
+
+		uint size() const { return dense.size(); }
+		T* data() { return dense.empty() ? NULL : &dense[0]; }
+		const PIXL_Entity* entities() const { return owners.empty() ? NULL : &owners[0]; }
+	private:
+		std::vector<uint32_t> sparse; // entity index -> position in dense
+		std::vector<T> dense;
+		std::vector<PIXL_Entity> owners; // entity of each dense component
+};
+
+
+/**
+ * @brief Entities plus one component pool per component type
+ *
+ * Systems are plain functions run from PIXL_App::update() or render():
+ *
+ *   world.each<Position, Velocity>([](PIXL_Entity e, Position& p, Velocity& v) {
+ *       p.x += v.x;
+ *       p.y += v.y;
+ *   });
+ *
+ * each() walks the pool of the first component type, so put the rarest one
+ * first. The function may destroy the entity it gets but no other one,
+ * that would move an entity not visited yet to a visited slot: keep those
+ * and destroy them after each().
+ */
+class PIXL_World {
+	public:
+		PIXL_World() {}
+		~PIXL_World();
+
+		PIXL_Entity create() { return entities.create(); }
+		void destroy(PIXL_Entity e);
+		bool isAlive(PIXL_Entity e) const { return entities.isAlive(e); }
+		uint count() const { return entities.count(); }
+
+		template<typename T>
+		T& add(PIXL_Entity e, const T& component = T())
+		{
+			assert(isAlive(e));
+			return pool<T>().add(e, component);
+		}
+
+		template<typename T>
+		void remove(PIXL_Entity e) { if(isAlive(e)) pool<T>().remove(e.index); }
+
+		template<typename T>
+		bool has(PIXL_Entity e) { return isAlive(e) && pool<T>().contains(e.index); }
+
+		template<typename T>
+		T& get(PIXL_Entity e)
+		{
+			assert(isAlive(e));
+			return pool<T>().at(e.index);
+		}
+
+		template<typename T>
+		PIXL_ComponentPool<T>& pool()
+		{
+			uint id = typeId<T>();
+			if(id >= pools.size())
+				pools.resize(id+1, NULL);
+			if(!pools[id])
+				pools[id] = new PIXL_ComponentPool<T>();
+			return *static_cast<PIXL_ComponentPool<T>*>(pools[id]);
+		}
+
+		template<typename First, typename... Rest, typename F>
+		void each(F fn)
+		{
+			std::tuple<PIXL_ComponentPool<Rest>*...> rest(&pool<Rest>()...);
+			each(fn, pool<First>(), rest, typename Sequence<sizeof...(Rest)>::type());
+		}
+	private:
+		// 0..N-1 as a pack, to index the tuple of pools by position
+		template<uint... I>
+		struct Indices {};
+
+		template<uint N, uint... I>
+		struct Sequence: Sequence<N-1, N-1, I...> {};
+
+		template<uint... I>
+		struct Sequence<0, I...> { typedef Indices<I...> type; };
+
+		template<typename F, typename T, typename Tuple, uint... I>
+		void each(F& fn, PIXL_ComponentPool<T>& first, Tuple& rest, Indices<I...>)
+		{
+			// fn may destroy the current entity, the last one is swapped into
+			// i then, so i only advances if it still holds e
+			for(uint i=0; i<first.size(); ) {
+				const PIXL_Entity e = first.entities()[i];
+				if(containsAll<0>(rest, e.index))
+					fn(e, first.data()[i], std::get<I>(rest)->at(e.index)...);
+				if(i < first.size() && first.entities()[i] == e)
+					i++;
+			}
+		}
+
+		static uint nextTypeId();
+
+		template<typename T>
+		static uint typeId()
+		{
+			static const uint id = nextTypeId();
+			return id;
+		}
+
+		template<uint I, typename Tuple>
+		static typename std::enable_if<I == std::tuple_size<Tuple>::value, bool>::type
+		containsAll(const Tuple&, uint32_t) { return true; }
+
+		template<uint I, typename Tuple>
+		static typename std::enable_if<(I < std::tuple_size<Tuple>::value), bool>::type
+		containsAll(const Tuple& t, uint32_t index) { return std::get<I>(t)->contains(index) && containsAll<I+1>(t, index); }
+
+		PIXL_World(const PIXL_World&);
+		PIXL_World& operator=(const PIXL_World&);
+
+		PIXL_EntityManager entities;
+		std::vector<PIXL_BaseComponentPool*> pools; // indexed by typeId()
+};
+
+#endif // _PIXL_ECS_H_
+
@@ -0,0 +1,347 @@
+/* 
+ * Copyright (C) 2012 - Brian Gomes Bascoy
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ * 
+ */
+
+#include "effects.h"
+
+#include <stdio.h>
+#include <string.h>
+
+/*
+ * Dual filter shaders, "w" and "h" are the size of the input
+ *
+ */
+
+static const char* blur_down_source =
+	"uniform sampler2D sampler0;\n"
+	"uniform float w;\n"
+	"uniform float h;\n"
+	"uniform float offset;\n"
+	"uniform float threshold;\n"
+	"void main()\n"
+	"{\n"
+	"	vec2 uv = gl_TexCoord[0].st;\n"
+	"	vec2 d = vec2(offset/w, offset/h);\n"
+	"	vec4 sum = texture2D(sampler0, uv) * 4.0;\n"
+	"	sum += texture2D(sampler0, uv - d);\n"
+	"	sum += texture2D(sampler0, uv + d);\n"
+	"	sum += texture2D(sampler0, uv + vec2(d.x, -d.y));\n"
+	"	sum += texture2D(sampler0, uv - vec2(d.x, -d.y));\n"
+	"	vec4 c = sum / 8.0;\n"
+	"	float b = max(c.r, max(c.g, c.b));\n"
+	"	gl_FragColor = c * (max(b - threshold, 0.0) / max(b, 0.0001));\n"
+	"}\n";
+
+static const char* blur_up_source =
+	"uniform sampler2D sampler0;\n"
+	"uniform float w;\n"
+	"uniform float h;\n"
+	"uniform float offset;\n"
+	"void main()\n"
+	"{\n"
+	"	vec2 uv = gl_TexCoord[0].st;\n"
+	"	vec2 d = vec2(offset/w, offset/h) * 0.5;\n"
+	"	vec4 sum = texture2D(sampler0, uv + vec2(-d.x * 2.0, 0.0));\n"
+	"	sum += texture2D(sampler0, uv + vec2(-d.x, d.y)) * 2.0;\n"
+	"	sum += texture2D(sampler0, uv + vec2(0.0, d.y * 2.0));\n"
+	"	sum += texture2D(sampler0, uv + vec2(d.x, d.y)) * 2.0;\n"
+	"	sum += texture2D(sampler0, uv + vec2(d.x * 2.0, 0.0));\n"
+	"	sum += texture2D(sampler0, uv + vec2(d.x, -d.y)) * 2.0;\n"
+	"	sum += texture2D(sampler0, uv + vec2(0.0, -d.y * 2.0));\n"
+	"	sum += texture2D(sampler0, uv + vec2(-d.x, -d.y)) * 2.0;\n"
+	"	gl_FragColor = sum / 12.0;\n"
+	"}\n";
+
+static const char* bloom_composite_source =
+	"uniform sampler2D sampler0;\n"
+	"uniform sampler2D sampler1;\n"
+	"uniform float intensity;\n"
+	"void main()\n"
+	"{\n"
+	"	vec2 uv = gl_TexCoord[0].st;\n"
+	"	gl_FragColor = texture2D(sampler0, uv) + texture2D(sampler1, uv) * intensity;\n"
+	"}\n";
+
+
+/**
+ * @brief Blur constructor
+ *
+ * @param q quality, levels of the pyramid (PIXL_Blur::low, medium or high)
+ */
+PIXL_Blur::PIXL_Blur(uint q): offset(1.f), threshold(0.f), intensity(0.f)
+{
+	static uint count = 0;
+	id = count++;
+
+	setQuality(q);
+
+	down = PIXL_compileShader(blur_down_source);
+	up = PIXL_compileShader(blur_up_source);
+	composite = PIXL_compileShader(bloom_composite_source);
+}
+
+PIXL_Blur::~PIXL_Blur()
+{
+	PIXL_gl.deleteProgram(down);
+	PIXL_gl.deleteProgram(up);
+	PIXL_gl.deleteProgram(composite);
+}
+
+/**
+ * @brief Append the passes of the effect to a render graph
+ *
+ * @param graph the graph
+ * @param input texture to blur
+ * @param output where to write the result ("screen" or another texture)
+ */
+void PIXL_Blur::addTo(PIXL_RenderGraph* graph, const char* input, const char* output)
+{
+	const bool bloom = intensity > 0;
+	char src[32];
+	char dst[32];
+	uint p;
+
+	snprintf(src, sizeof(src), "%s", input);
+
+	for(uint k=1; k<=quality; k++) {
+		snprintf(dst, sizeof(dst), "blur%u_%u", id, k);
+		p = graph->addPass(down, src, dst, 1.f/(1 << k));
+		graph->setUniform(p, "offset", offset);
+		// the bright pass is folded into the first downsample
+		graph->setUniform(p, "threshold", bloom && k == 1 ? threshold : 0.f);
+		snprintf(src, sizeof(src), "%s", dst);
+	}
+
+	// with bloom we stop at half resolution and add it to the input
+	const uint last = bloom ? 1 : 0;
+	for(int k=quality-1; k>=(int)last; k--) {
+		if(k == 0)
+			snprintf(dst, sizeof(dst), "%s", output);
+		else
+			snprintf(dst, sizeof(dst), "blur%u_up%u", id, k);
+		p = graph->addPass(up, src, dst, 1.f/(1 << k));
+		graph->setUniform(p, "offset", offset);
+		snprintf(src, sizeof(src), "%s", dst);
+	}
+
+	if(bloom) {
+		p = graph->addPass(composite, input, output);
+		graph->addInput(p, src);
+		graph->setUniform(p, "intensity", intensity);
+	}
+}
+
+
+
+/*
+ * Per-pixel effects
+ *
+ */
+
+const char* PIXL_EFFECT_GRADE =
+	"c.rgb = (c.rgb - 0.5) * p.y + 0.5 * p.x;\n"
+	"c.rgb = mix(vec3(dot(c.rgb, vec3(0.299, 0.587, 0.114))), c.rgb, p.z);\n";
+
+const char* PIXL_EFFECT_INVERT =
+	"c.rgb = mix(c.rgb, 1.0 - c.rgb, p.x);\n";
+
+const char* PIXL_EFFECT_SCANLINES =
+	"c.rgb *= 1.0 - p.x * step(0.5 * p.y, mod(uv.y * h + p.z, p.y));\n";
+
+const char* PIXL_EFFECT_VIGNETTE =
+	"c.rgb *= 1.0 - p.x * smoothstep(p.y, 1.0, length(uv - 0.5) * 1.414);\n";
+
+
+PIXL_EffectStack::PIXL_EffectStack(): graph(NULL), pass_count(0)
+{
+	static uint count = 0;
+	id = count++;
+}
+
+PIXL_EffectStack::~PIXL_EffectStack()
+{
+	for(uint i=0; i<programs.size(); i++)
+		PIXL_gl.deleteProgram(programs[i]);
+}
+
+/**
+ * @brief Append a per-pixel effect
+ *
+ * @param code GLSL statements modifying "c" (see PIXL_EFFECT_GRADE)
+ * @param p0 parameters, "p" in the code
+ * @return index of the effect for setParams()
+ */
+uint PIXL_EffectStack::add(const char* code, float p0, float p1, float p2, float p3)
+{
+	Effect e;
+	e.code = code;
+	e.shader = 0;
+	e.blur = NULL;
+	e.pass = -1;
+	effects.push_back(e);
+	setParams(effects.size()-1, p0, p1, p2, p3);
+	return effects.size()-1;
+}
+
+/**
+ * @brief Append a full screen shader in its own pass
+ *
+ * @note Same conventions as PIXL_loadShader(), the program is not deleted
+ */
+uint PIXL_EffectStack::add(GLuint shader)
+{
+	Effect e;
+	e.shader = shader;
+	e.blur = NULL;
+	e.pass = -1;
+	memset(e.params, 0, sizeof(e.params));
+	effects.push_back(e);
+	return effects.size()-1;
+}
+
+/**
+ * @brief Append a blur, configured before addTo()
+ */
+uint PIXL_EffectStack::add(PIXL_Blur* blur)
+{
+	Effect e;
+	e.shader = 0;
+	e.blur = blur;
+	e.pass = -1;
+	memset(e.params, 0, sizeof(e.params));
+	effects.push_back(e);
+	return effects.size()-1;
+}
+
+/**
+ * @brief Change the parameters of a per-pixel effect
+ */
+void PIXL_EffectStack::setParams(uint effect, float p0, float p1, float p2, float p3)
+{
+	Effect& e = effects[effect];
+	e.params[0] = p0;
+	e.params[1] = p1;
+	e.params[2] = p2;
+	e.params[3] = p3;
+
+	if(graph && e.pass >= 0)
+		upload(effect);
+}
+
+void PIXL_EffectStack::upload(uint effect)
+{
+	char name[16];
+	for(uint k=0; k<4; k++) {
+		snprintf(name, sizeof(name), "e%u_%u", effect, k);
+		graph->setUniform(effects[effect].pass, name, effects[effect].params[k]);
+	}
+}
+
+/**
+ * @brief Generate the shader running the effects first to last in one pass
+ */
+GLuint PIXL_EffectStack::generate(uint first, uint last)
+{
+	std::string source =
+		"uniform sampler2D sampler0;\n"
+		"uniform float w;\n"
+		"uniform float h;\n";
+
+	char line[128];
+	for(uint i=first; i<=last; i++) {
+		snprintf(line, sizeof(line), "uniform float e%u_0, e%u_1, e%u_2, e%u_3;\n", i, i, i, i);
+		source += line;
+	}
+
+	source +=
+		"void main()\n"
+		"{\n"
+		"	vec2 uv = gl_TexCoord[0].st;\n"
+		"	vec4 c = texture2D(sampler0, uv);\n"
+		"	vec4 p;\n";
+
+	for(uint i=first; i<=last; i++) {
+		snprintf(line, sizeof(line), "	p = vec4(e%u_0, e%u_1, e%u_2, e%u_3);\n", i, i, i, i);
+		source += line;
+		source += "	{\n" + effects[i].code + "	}\n";
+	}
+
+	source +=
+		"	gl_FragColor = c;\n"
+		"}\n";
+
+	return PIXL_compileShader(source.c_str());
+}
+
+/**
+ * @brief Append the effects to a render graph
+ *
+ * Call it again after adding effects (with a cleared graph), the generated
+ * shaders are rebuilt.
+ *
+ * @param graph the graph
+ * @param input texture to process
+ * @param output where to write the result ("screen" or another texture)
+ */
+void PIXL_EffectStack::addTo(PIXL_RenderGraph* g, const char* input, const char* output)
+{
+	for(uint i=0; i<programs.size(); i++)
+		PIXL_gl.deleteProgram(programs[i]);
+	programs.clear();
+
+	graph = g;
+	pass_count = 0;
+
+	char src[32];
+	char dst[32];
+	snprintf(src, sizeof(src), "%s", input);
+
+	uint i = 0;
+	while(i < effects.size()) {
+		// extend the chain while the effects are per-pixel
+		uint last = i;
+		if(!effects[i].shader && !effects[i].blur) {
+			while(last+1 < effects.size() && !effects[last+1].shader && !effects[last+1].blur)
+				last++;
+		}
+
+		if(last+1 == effects.size())
+			snprintf(dst, sizeof(dst), "%s", output);
+		else
+			snprintf(dst, sizeof(dst), "fx%u_%u", id, pass_count);
+
+		if(effects[i].blur) {
+			effects[i].blur->addTo(graph, src, dst);
+		}
+		else if(effects[i].shader) {
+			effects[i].pass = graph->addPass(effects[i].shader, src, dst);
+		}
+		else {
+			GLuint program = generate(i, last);
+			programs.push_back(program);
+			uint pass = graph->addPass(program, src, dst);
+			for(uint k=i; k<=last; k++) {
+				effects[k].pass = pass;
+				upload(k);
+			}
+		}
+
+		pass_count++;
+		snprintf(src, sizeof(src), "%s", dst);
+		i = last+1;
+	}
+}
@@ -0,0 +1,121 @@
+/* 
+ * Copyright (C) 2012 - Brian Gomes Bascoy
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ * 
+ */
+
+#ifndef _PIXL_EFFECTS_H_
+#define _PIXL_EFFECTS_H_
+
+#include <GL/glew.h>
+
+#include <string>
+#include <vector>
+
+#include "config.h"
+#include "app.h"
+#include "rendergraph.h"
+
+/**
+ * @brief Dual filter (Kawase) blur and bloom
+ *
+ * The image is downsampled to 1/2, 1/4... of the resolution and then
+ * upsampled back, 5 texture reads per pixel going down and 8 going up, so
+ * most of the work happens at a fraction of the resolution. The quality is
+ * the number of levels of the pyramid. With bloom only the pixels above the
+ * threshold are blurred and the result is added to the input.
+ *
+ * The passes are appended to a render graph, after changing the settings
+ * the graph has to be built again (see PIXL_RenderGraph::clear()).
+ */
+class PIXL_Blur {
+	public:
+		enum { low = 2, medium = 3, high = 4 };
+		PIXL_Blur(uint q = medium);
+		virtual ~PIXL_Blur();
+		void setQuality(uint q) { quality = q < 1 ? 1 : (q > 8 ? 8 : q); }
+		void setOffset(float o) { offset=o; }
+		void setBloom(float t, float i) { threshold=t; intensity=i; }
+		void addTo(PIXL_RenderGraph* graph, const char* input, const char* output);
+	private:
+		GLuint down;
+		GLuint up;
+		GLuint composite;
+		uint quality; // levels of the pyramid
+		float offset; // sample distance, in texels
+		float threshold; // bloom threshold
+		float intensity; // bloom intensity, 0 for a plain blur
+		uint id; // to name our targets in the graph
+};
+
+/**
+ * @brief Built-in per-pixel effects for PIXL_EffectStack
+ *
+ * The code works on the colour "c" at "uv", with the parameters of the
+ * effect in "p" and the size of the input in "w" and "h".
+ */
+extern const char* PIXL_EFFECT_GRADE; // p: brightness, contrast, saturation
+extern const char* PIXL_EFFECT_INVERT; // p.x: amount
+extern const char* PIXL_EFFECT_SCANLINES; // p: intensity, period in pixels, scroll
+extern const char* PIXL_EFFECT_VIGNETTE; // p: strength, radius
+
+
+/**
+ * @brief Chain of post-processing effects
+ *
+ * Consecutive per-pixel effects are concatenated into one generated
+ * fragment shader, so they cost a single read and write of the image
+ * however many there are. Only the effects that sample their neighbours
+ * (a shader with add(GLuint) or a blur) break the chain into another pass.
+ *
+ * Example:
+ *
+ *   stack.add(PIXL_EFFECT_GRADE, 1.1f, 1.2f, 0.8f);
+ *   stack.add(PIXL_loadShader("gbh.glsl"));
+ *   stack.add(PIXL_EFFECT_SCANLINES, 0.3f, 3.f);
+ *   stack.add(PIXL_EFFECT_VIGNETTE, 0.6f);
+ *   stack.addTo(&graph, "scene", "screen"); // 3 passes: grade, gbh, scanlines + vignette
+ *
+ * The parameters can be changed with setParams() after addTo().
+ */
+class PIXL_EffectStack {
+	public:
+		PIXL_EffectStack();
+		virtual ~PIXL_EffectStack();
+		uint add(const char* code, float p0=0, float p1=0, float p2=0, float p3=0);
+		uint add(GLuint shader);
+		uint add(PIXL_Blur* blur);
+		void setParams(uint effect, float p0, float p1=0, float p2=0, float p3=0);
+		void addTo(PIXL_RenderGraph* graph, const char* input, const char* output);
+		uint getPassCount() { return pass_count; }
+	private:
+		struct Effect {
+			std::string code; // per-pixel effects
+			GLuint shader; // effects sampling their neighbours
+			PIXL_Blur* blur;
+			float params[4];
+			int pass; // in the graph, -1 until addTo()
+		};
+		GLuint generate(uint first, uint last);
+		void upload(uint effect);
+		std::vector<Effect> effects;
+		std::vector<GLuint> programs; // generated shaders we own
+		PIXL_RenderGraph* graph;
+		uint pass_count;
+		uint id; // to name our targets in the graph
+};
+
+#endif // _PIXL_EFFECTS_H_
+
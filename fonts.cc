@@ -0,0 +1,122 @@
+/* 
+ * Copyright (C) 2012 - Brian Gomes Bascoy
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ * 
+ */
+
+#include "fonts.h"
+
+#include <stdio.h>
+
+/*
+ * One registry for the whole process, like PIXL_config
+ *
+ */
+PIXL_FontRegistry PIXL_fonts;
+
+
+PIXL_FontRegistry::~PIXL_FontRegistry()
+{
+	std::map<Key, Entry>::iterator e;
+	for(e=entries.begin(); e!=entries.end(); ++e) {
+		if(e->second.context)
+			g_object_unref(e->second.context);
+		pango_font_description_free(e->second.description);
+	}
+
+	std::map<std::string, FcPattern*>::iterator p;
+	for(p=patterns.begin(); p!=patterns.end(); ++p)
+		if(p->second)
+			FcPatternDestroy(p->second);
+}
+
+/**
+ * @brief Register a font file in fontconfig and get its pattern, only once
+ */
+FcPattern* PIXL_FontRegistry::load(const std::string& file)
+{
+	std::map<std::string, FcPattern*>::iterator it = patterns.find(file);
+	if(it != patterns.end())
+		return it->second;
+
+	const FcChar8* name = (const FcChar8*)file.c_str();
+	FcBlanks* blanks = FcBlanksCreate(); //para errores de fuentes
+	int count = 0;
+
+	if(!FcConfigAppFontAddFile(FcConfigGetCurrent(), name)) {
+		printf("ERROR FontConfig!\n");
+	}
+	FcPattern* pattern = FcFreeTypeQuery(name, 0, blanks, &count);
+	FcBlanksDestroy(blanks);
+
+	files_loaded++;
+	patterns[file] = pattern;
+
+	return pattern;
+}
+
+PIXL_FontRegistry::Entry* PIXL_FontRegistry::find(const char* file, uint size)
+{
+	std::lock_guard<std::recursive_mutex> lock(mutex);
+	Key key(file, size);
+	std::map<Key, Entry>::iterator it = entries.find(key);
+	if(it != entries.end())
+		return &it->second;
+
+	FcPattern* pattern = load(key.first);
+
+	Entry entry;
+	if(pattern) {
+		entry.description = pango_fc_font_description_from_pattern(pattern, 0);
+	} else {
+		// the file could not be read, let Pango fall back to its default font
+		entry.description = pango_font_description_new();
+	}
+	pango_font_description_set_size(entry.description, size*PANGO_SCALE);
+	entry.context = NULL; // created on demand
+
+	return &(entries[key] = entry);
+}
+
+/**
+ * @brief Font description of a font file at a given size
+ *
+ * @param file font file
+ * @param size size in points
+ */
+const PangoFontDescription* PIXL_FontRegistry::getDescription(const char* file, uint size)
+{
+	return find(file, size)->description;
+}
+
+/**
+ * @brief Pango context whose default font is the given font file and size
+ *
+ * @note Layouts created with pango_layout_new() on it can be drawn with
+ * pango_cairo_show_layout() on any cairo context.
+ */
+PangoContext* PIXL_FontRegistry::getContext(const char* file, uint size)
+{
+	std::lock_guard<std::recursive_mutex> lock(mutex);
+	Entry* entry = find(file, size);
+
+	if(!entry->context) {
+		entry->context = pango_font_map_create_context(pango_cairo_font_map_get_default());
+		pango_context_set_font_description(entry->context, entry->description);
+	}
+
+	return entry->context;
+}
+
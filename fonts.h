@@ -0,0 +1,70 @@
+/* 
+ * Copyright (C) 2012 - Brian Gomes Bascoy
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ * 
+ */
+
+#ifndef _PIXL_FONTS_H_
+#define _PIXL_FONTS_H_
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <fontconfig/fontconfig.h>
+#include <pango/pangocairo.h>
+#include <pango/pangofc-fontmap.h>
+
+#include "config.h"
+
+/**
+ * @brief Process wide font cache
+ *
+ * Every font file is registered in fontconfig and queried only once, font
+ * descriptions and Pango contexts are shared by every text object using the
+ * same (file, size). Everything returned belongs to the registry.
+ *
+ * Layers can be drawn from several threads (see PIXL_LayerJobs): the
+ * registry locks itself, and since the contexts are shared the Pango calls
+ * on their layouts have to hold getMutex() too.
+ */
+class PIXL_FontRegistry {
+	public:
+		PIXL_FontRegistry(): files_loaded(0) {}
+		~PIXL_FontRegistry();
+		const PangoFontDescription* getDescription(const char* file, uint size);
+		PangoContext* getContext(const char* file, uint size);
+		uint getFilesLoaded() { return files_loaded; }
+		std::recursive_mutex& getMutex() { return mutex; }
+	private:
+		typedef std::pair<std::string, uint> Key;
+		typedef struct {
+			PangoFontDescription* description;
+			PangoContext* context;
+		} Entry;
+
+		FcPattern* load(const std::string& file);
+		Entry* find(const char* file, uint size);
+
+		std::map<std::string, FcPattern*> patterns;
+		std::map<Key, Entry> entries;
+		uint files_loaded;
+		std::recursive_mutex mutex;
+};
+
+extern PIXL_FontRegistry PIXL_fonts;
+
+#endif // _PIXL_FONTS_H_
+
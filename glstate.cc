@@ -0,0 +1,199 @@
+/* 
+ * Copyright (C) 2012 - Brian Gomes Bascoy
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ * 
+ */
+
+#include "glstate.h"
+
+#include <stddef.h>
+
+/*
+ * All GL calls happen on the main thread, one shadow is enough
+ *
+ */
+PIXL_GLState PIXL_gl;
+
+
+PIXL_GLState::Cap* PIXL_GLState::findCap(GLenum cap, bool client)
+{
+	for(uint i=0; i<caps.size(); i++)
+		if(caps[i].cap == cap && caps[i].client == client)
+			return &caps[i];
+	return NULL;
+}
+
+void PIXL_GLState::setCap(GLenum cap, bool enabled)
+{
+	Cap* c = findCap(cap, false);
+	if(c && c->enabled == enabled) {
+		saved++;
+		return;
+	}
+
+	if(enabled)
+		glEnable(cap);
+	else
+		glDisable(cap);
+	issued++;
+
+	if(c) {
+		c->enabled = enabled;
+	} else {
+		Cap n = { cap, false, enabled };
+		caps.push_back(n);
+	}
+}
+
+void PIXL_GLState::setClientState(GLenum array, bool enabled)
+{
+	Cap* c = findCap(array, true);
+	if(c && c->enabled == enabled) {
+		saved++;
+		return;
+	}
+
+	if(enabled)
+		glEnableClientState(array);
+	else
+		glDisableClientState(array);
+	issued++;
+
+	if(c) {
+		c->enabled = enabled;
+	} else {
+		Cap n = { array, true, enabled };
+		caps.push_back(n);
+	}
+}
+
+/**
+ * @brief Like glIsEnabled(), asks GL only the first time
+ */
+bool PIXL_GLState::isEnabled(GLenum cap)
+{
+	Cap* c = findCap(cap, false);
+	if(c) {
+		saved++;
+		return c->enabled;
+	}
+
+	issued++;
+	Cap n = { cap, false, glIsEnabled(cap) == GL_TRUE };
+	caps.push_back(n);
+	return n.enabled;
+}
+
+/**
+ * @brief Current blend factors, asks GL only if they are unknown
+ */
+void PIXL_GLState::getBlendFunc(GLenum* src, GLenum* dst)
+{
+	if(blend_src == unknown || blend_dst == unknown) {
+		GLint s, d;
+		glGetIntegerv(GL_BLEND_SRC, &s);
+		glGetIntegerv(GL_BLEND_DST, &d);
+		blend_src = s;
+		blend_dst = d;
+		issued++;
+	} else {
+		saved++;
+	}
+	*src = blend_src;
+	*dst = blend_dst;
+}
+
+void PIXL_GLState::bindBuffer(GLenum target, GLuint buffer)
+{
+	GLuint* bound = NULL;
+	if(target == GL_ARRAY_BUFFER)
+		bound = &array_buffer;
+	else if(target == GL_ELEMENT_ARRAY_BUFFER)
+		bound = &element_buffer;
+
+	if(bound && *bound == buffer) {
+		saved++;
+		return;
+	}
+
+	glBindBuffer(target, buffer);
+	if(bound)
+		*bound = buffer;
+	issued++;
+}
+
+void PIXL_GLState::deleteTextures(GLsizei n, const GLuint* ids)
+{
+	for(GLsizei i=0; i<n; i++)
+		for(uint u=0; u<units; u++)
+			if(textures[u] == ids[i])
+				textures[u] = 0;
+	glDeleteTextures(n, ids);
+}
+
+void PIXL_GLState::deleteFramebuffers(GLsizei n, const GLuint* ids)
+{
+	for(GLsizei i=0; i<n; i++)
+		if(framebuffer == ids[i])
+			framebuffer = 0;
+	glDeleteFramebuffers(n, ids);
+}
+
+void PIXL_GLState::deleteBuffers(GLsizei n, const GLuint* ids)
+{
+	for(GLsizei i=0; i<n; i++) {
+		if(array_buffer == ids[i])
+			array_buffer = 0;
+		if(element_buffer == ids[i])
+			element_buffer = 0;
+	}
+	glDeleteBuffers(n, ids);
+}
+
+void PIXL_GLState::deleteProgram(GLuint id)
+{
+	// GL keeps using a deleted program until another one is bound
+	if(program == id)
+		useProgram(0);
+	glDeleteProgram(id);
+}
+
+/**
+ * @brief Forget everything, the next calls go to GL
+ */
+void PIXL_GLState::invalidate()
+{
+	caps.clear();
+	active_unit = unknown;
+	for(uint i=0; i<units; i++)
+		textures[i] = unknown;
+	program = unknown;
+	framebuffer = unknown;
+	array_buffer = unknown;
+	element_buffer = unknown;
+	blend_src = blend_dst = unknown;
+	view[0] = view[1] = view[2] = view[3] = -1;
+}
+
+/**
+ * @brief Start counting the calls of a new frame
+ */
+void PIXL_GLState::newFrame()
+{
+	last_issued = issued;
+	last_saved = saved;
+	issued = saved = 0;
+}
+
@@ -0,0 +1,146 @@
+/* 
+ * Copyright (C) 2012 - Brian Gomes Bascoy
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ * 
+ */
+
+#ifndef _PIXL_GLSTATE_H_
+#define _PIXL_GLSTATE_H_
+
+#include <vector>
+#include <GL/glew.h>
+
+#include "config.h"
+
+/**
+ * @brief Shadow of the GL state, skips the calls that change nothing
+ *
+ * Every engine draw goes through PIXL_gl and sets the state it needs
+ * without restoring it afterwards, so consecutive sprites don't toggle
+ * GL_TEXTURE_2D or rebind the same texture. Code drawing untextured
+ * geometry has to disable(GL_TEXTURE_2D) itself. Objects have to be
+ * deleted here too, GL unbinds them behind our back otherwise, and after
+ * touching the state directly call invalidate().
+ *
+ * getIssued() and getSaved() count the calls of the last frame.
+ */
+class PIXL_GLState {
+	public:
+		PIXL_GLState(): issued(0), saved(0) { invalidate(); newFrame(); }
+
+		void enable(GLenum cap) { setCap(cap, true); }
+		void disable(GLenum cap) { setCap(cap, false); }
+		bool isEnabled(GLenum cap);
+		void enableClientState(GLenum array) { setClientState(array, true); }
+		void disableClientState(GLenum array) { setClientState(array, false); }
+
+		void activeTexture(GLenum unit)
+		{
+			if(unit == active_unit) { saved++; return; }
+			glActiveTexture(unit);
+			active_unit = unit;
+			issued++;
+		}
+
+		// GL_TEXTURE_2D of the active unit
+		void bindTexture(GLuint texture)
+		{
+			if(active_unit == unknown) { glBindTexture(GL_TEXTURE_2D, texture); issued++; return; }
+			GLuint& bound = textures[(active_unit - GL_TEXTURE0) % units];
+			if(texture == bound) { saved++; return; }
+			glBindTexture(GL_TEXTURE_2D, texture);
+			bound = texture;
+			issued++;
+		}
+
+		void useProgram(GLuint p)
+		{
+			if(p == program) { saved++; return; }
+			glUseProgram(p);
+			program = p;
+			issued++;
+		}
+
+		void bindFramebuffer(GLuint fbo)
+		{
+			if(fbo == framebuffer) { saved++; return; }
+			glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+			framebuffer = fbo;
+			issued++;
+		}
+
+		void bindBuffer(GLenum target, GLuint buffer);
+
+		void blendFunc(GLenum src, GLenum dst)
+		{
+			if(src == blend_src && dst == blend_dst) { saved++; return; }
+			glBlendFunc(src, dst);
+			blend_src = src;
+			blend_dst = dst;
+			issued++;
+		}
+
+		void getBlendFunc(GLenum* src, GLenum* dst);
+
+		void viewport(GLint x, GLint y, GLsizei w, GLsizei h)
+		{
+			if(x == view[0] && y == view[1] && w == view[2] && h == view[3]) { saved++; return; }
+			glViewport(x, y, w, h);
+			view[0] = x; view[1] = y; view[2] = w; view[3] = h;
+			issued++;
+		}
+
+		void deleteTextures(GLsizei n, const GLuint* ids);
+		void deleteFramebuffers(GLsizei n, const GLuint* ids);
+		void deleteBuffers(GLsizei n, const GLuint* ids);
+		void deleteProgram(GLuint id);
+
+		void invalidate();
+		void newFrame();
+		uint getIssued() { return last_issued; }
+		uint getSaved() { return last_saved; }
+
+	private:
+		enum { units = 8, unknown = 0xFFFFFFFFu };
+		typedef struct {
+			GLenum cap;
+			bool client; // glEnableClientState()
+			bool enabled;
+		} Cap;
+
+		void setCap(GLenum cap, bool enabled);
+		void setClientState(GLenum array, bool enabled);
+		Cap* findCap(GLenum cap, bool client);
+
+		std::vector<Cap> caps; // only the ones we have seen, a handful
+		GLenum active_unit;
+		GLuint textures[units];
+		GLuint program;
+		GLuint framebuffer;
+		GLuint array_buffer;
+		GLuint element_buffer;
+		GLenum blend_src;
+		GLenum blend_dst;
+		GLint view[4];
+		uint issued; // calls this frame
+		uint saved;
+		uint last_issued; // calls last frame
+		uint last_saved;
+};
+
+extern PIXL_GLState PIXL_gl;
+
+#endif // _PIXL_GLSTATE_H_
+
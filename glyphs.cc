@@ -0,0 +1,285 @@
+/* 
+ * Copyright (C) 2012 - Brian Gomes Bascoy
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ * 
+ */
+
+#include "glyphs.h"
+
+#include <cmath>
+#include <stdio.h>
+#include <string.h>
+
+// strings that change every frame would make the shaping cache grow forever
+static const uint max_cached_strings = 256;
+
+/**
+ * @brief Glyph atlas constructor
+ *
+ * @param w atlas texture width
+ * @param h atlas texture height
+ */
+PIXL_GlyphAtlas::PIXL_GlyphAtlas(uint w, uint h): width(w), height(h), pen_x(0), pen_y(0), shelf_h(0)
+{
+	glGenTextures(1, &texture);
+	PIXL_gl.bindTexture(texture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	std::vector<GLubyte> empty(width*height, 0);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_ALPHA8, width, height, 0, GL_ALPHA, GL_UNSIGNED_BYTE, &empty[0]);
+}
+
+PIXL_GlyphAtlas::~PIXL_GlyphAtlas()
+{
+	std::map<std::pair<PangoFont*, PangoGlyph>, int>::iterator it;
+	for(it=index.begin(); it!=index.end(); ++it)
+		g_object_unref(it->first.first);
+
+	PIXL_gl.deleteTextures(1, &texture);
+}
+
+/**
+ * @brief Get the slot of a glyph, rasterizing it the first time
+ *
+ * @return slot index, or -1 if the atlas is full
+ */
+int PIXL_GlyphAtlas::find(PangoFont* font, PangoGlyph glyph)
+{
+	std::pair<PangoFont*, PangoGlyph> key(font, glyph);
+	std::map<std::pair<PangoFont*, PangoGlyph>, int>::iterator it = index.find(key);
+	if(it != index.end())
+		return it->second;
+
+	PangoRectangle ink;
+	pango_font_get_glyph_extents(font, glyph, &ink, NULL);
+
+	Slot slot;
+	slot.x = (int)floor(ink.x/(double)PANGO_SCALE);
+	slot.y = (int)floor(ink.y/(double)PANGO_SCALE);
+	slot.w = (int)ceil((ink.x+ink.width)/(double)PANGO_SCALE) - slot.x;
+	slot.h = (int)ceil((ink.y+ink.height)/(double)PANGO_SCALE) - slot.y;
+	slot.s0 = slot.t0 = slot.s1 = slot.t1 = 0;
+
+	if(slot.w > 0 && slot.h > 0) {
+		// 1 pixel of padding so neighbours don't bleed
+		if(pen_x + slot.w + 1 > width) {
+			pen_x = 0;
+			pen_y += shelf_h + 1;
+			shelf_h = 0;
+		}
+		if(pen_y + slot.h + 1 > height || (uint)slot.w + 1 > width) {
+			puts("Glyph atlas full");
+			return -1;
+		}
+
+		cairo_surface_t* surface = cairo_image_surface_create(CAIRO_FORMAT_A8, slot.w, slot.h);
+		cairo_t* cr = cairo_create(surface);
+
+		PangoGlyphString* glyphs = pango_glyph_string_new();
+		pango_glyph_string_set_size(glyphs, 1);
+		glyphs->glyphs[0].glyph = glyph;
+		glyphs->glyphs[0].geometry.width = 0;
+		glyphs->glyphs[0].geometry.x_offset = 0;
+		glyphs->glyphs[0].geometry.y_offset = 0;
+		glyphs->glyphs[0].attr.is_cluster_start = 1;
+
+		cairo_move_to(cr, -slot.x, -slot.y); // pen on the baseline
+		pango_cairo_show_glyph_string(cr, font, glyphs);
+		cairo_surface_flush(surface);
+
+		PIXL_gl.bindTexture(texture);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glPixelStorei(GL_UNPACK_ROW_LENGTH, cairo_image_surface_get_stride(surface));
+		glTexSubImage2D(GL_TEXTURE_2D, 0, pen_x, pen_y, slot.w, slot.h, GL_ALPHA, GL_UNSIGNED_BYTE, cairo_image_surface_get_data(surface));
+		glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+		pango_glyph_string_free(glyphs);
+		cairo_destroy(cr);
+		cairo_surface_destroy(surface);
+
+		slot.s0 = pen_x/(float)width;
+		slot.t0 = pen_y/(float)height;
+		slot.s1 = (pen_x+slot.w)/(float)width;
+		slot.t1 = (pen_y+slot.h)/(float)height;
+
+		pen_x += slot.w + 1;
+		if((uint)slot.h > shelf_h)
+			shelf_h = slot.h;
+	}
+
+	g_object_ref(font);
+	slots.push_back(slot);
+	index[key] = slots.size()-1;
+
+	return slots.size()-1;
+}
+
+
+/**
+ * @brief Text renderer constructor
+ *
+ * @param f font file
+ * @param s font size
+ */
+PIXL_TextRenderer::PIXL_TextRenderer(const char* f, uint s)
+{
+	// the contexts are shared with PIXL_Text, maybe printing on a worker
+	std::lock_guard<std::recursive_mutex> lock(PIXL_fonts.getMutex());
+	layout = pango_layout_new(PIXL_fonts.getContext(f, s));
+	setColor(1, 1, 1, 1);
+}
+
+PIXL_TextRenderer::~PIXL_TextRenderer()
+{
+	std::lock_guard<std::recursive_mutex> lock(PIXL_fonts.getMutex());
+	g_object_unref(layout);
+}
+
+void PIXL_TextRenderer::setColor(float r, float g, float b, float a)
+{
+	color[0] = (GLubyte)(r*255);
+	color[1] = (GLubyte)(g*255);
+	color[2] = (GLubyte)(b*255);
+	color[3] = (GLubyte)(a*255);
+}
+
+/**
+ * @brief Lay out a string with Pango, or get it from the cache
+ */
+const std::vector<PIXL_TextRenderer::PlacedGlyph>& PIXL_TextRenderer::shape(const char* text)
+{
+	std::string key(text);
+	std::map<std::string, std::vector<PlacedGlyph> >::iterator it = cache.find(key);
+	if(it != cache.end())
+		return it->second;
+
+	if(cache.size() >= max_cached_strings)
+		cache.clear();
+
+	std::vector<PlacedGlyph>& placed = cache[key];
+
+	std::lock_guard<std::recursive_mutex> lock(PIXL_fonts.getMutex());
+	pango_layout_set_text(layout, text, -1);
+	PangoLayoutIter* iter = pango_layout_get_iter(layout);
+	do {
+		PangoLayoutRun* run = pango_layout_iter_get_run_readonly(iter);
+		if(!run)
+			continue; // end of a line
+
+		PangoRectangle logical;
+		pango_layout_iter_get_run_extents(iter, NULL, &logical);
+		int baseline = pango_layout_iter_get_baseline(iter);
+		int x = logical.x;
+
+		PangoFont* font = run->item->analysis.font;
+		for(int i=0; i<run->glyphs->num_glyphs; i++) {
+			PangoGlyphInfo* info = &run->glyphs->glyphs[i];
+			if(info->glyph != PANGO_GLYPH_EMPTY) {
+				PlacedGlyph g;
+				g.slot = atlas.find(font, info->glyph);
+				g.x = (x + info->geometry.x_offset)/(float)PANGO_SCALE;
+				g.y = (baseline + info->geometry.y_offset)/(float)PANGO_SCALE;
+				if(g.slot >= 0 && atlas.getSlot(g.slot).w > 0)
+					placed.push_back(g);
+			}
+			x += info->geometry.width;
+		}
+	} while(pango_layout_iter_next_run(iter));
+	pango_layout_iter_free(iter);
+
+	return placed;
+}
+
+/**
+ * @brief Queue a string, it will be drawn on the next draw()
+ *
+ * @param text UTF-8 string, newlines are allowed
+ * @param x x-position of the top left corner
+ * @param y y-position of the top left corner
+ */
+void PIXL_TextRenderer::print(const char* text, int x, int y)
+{
+	const std::vector<PlacedGlyph>& placed = shape(text);
+
+	for(uint i=0; i<placed.size(); i++) {
+		const PIXL_GlyphAtlas::Slot& slot = atlas.getSlot(placed[i].slot);
+		GLfloat x0 = x + placed[i].x + slot.x;
+		GLfloat y0 = y + placed[i].y + slot.y;
+		PIXL_Vertex v[4] = {
+			{ x0, y0, slot.s0, slot.t0, {0} },
+			{ x0, y0+slot.h, slot.s0, slot.t1, {0} },
+			{ x0+slot.w, y0+slot.h, slot.s1, slot.t1, {0} },
+			{ x0+slot.w, y0, slot.s1, slot.t0, {0} },
+		};
+		for(int j=0; j<4; j++) {
+			for(int c=0; c<4; c++)
+				v[j].color[c] = color[c];
+			vertices.push_back(v[j]);
+		}
+	}
+}
+
+/**
+ * @brief Queue a text with a world transform, see PIXL_SceneGraph
+ *
+ * @param m the top left corner of the text is at its origin
+ */
+void PIXL_TextRenderer::print(const char* text, const PIXL_Affine& m)
+{
+	const std::vector<PlacedGlyph>& placed = shape(text);
+
+	for(uint i=0; i<placed.size(); i++) {
+		const PIXL_GlyphAtlas::Slot& slot = atlas.getSlot(placed[i].slot);
+		GLfloat x0 = placed[i].x + slot.x;
+		GLfloat y0 = placed[i].y + slot.y;
+		GLfloat x1 = x0 + slot.w;
+		GLfloat y1 = y0 + slot.h;
+		PIXL_Vertex v[4] = {
+			{ m.getX(x0, y0), m.getY(x0, y0), slot.s0, slot.t0, {0} },
+			{ m.getX(x0, y1), m.getY(x0, y1), slot.s0, slot.t1, {0} },
+			{ m.getX(x1, y1), m.getY(x1, y1), slot.s1, slot.t1, {0} },
+			{ m.getX(x1, y0), m.getY(x1, y0), slot.s1, slot.t0, {0} },
+		};
+		for(int j=0; j<4; j++) {
+			for(int c=0; c<4; c++)
+				v[j].color[c] = color[c];
+			vertices.push_back(v[j]);
+		}
+	}
+}
+
+/**
+ * @brief Draw everything printed since the last call with one draw call
+ */
+void PIXL_TextRenderer::draw()
+{
+	if(vertices.empty())
+		return;
+
+	// GL_MODULATE takes the colour from the vertices and the alpha from the atlas
+	PIXL_gl.enable(GL_TEXTURE_2D);
+	PIXL_gl.bindTexture(atlas.getTexture());
+
+	const uint batch = PIXL_stream.getCapacity() & ~3u;
+	for(uint first=0; first<vertices.size(); first+=batch) {
+		uint n = vertices.size()-first < batch ? vertices.size()-first : batch;
+		memcpy(PIXL_stream.map(n), &vertices[first], n*sizeof(PIXL_Vertex));
+		PIXL_stream.draw(GL_QUADS);
+	}
+
+	vertices.clear();
+}
+
@@ -0,0 +1,98 @@
+/* 
+ * Copyright (C) 2012 - Brian Gomes Bascoy
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ * 
+ */
+
+#ifndef _PIXL_GLYPHS_H_
+#define _PIXL_GLYPHS_H_
+
+#include <map>
+#include <vector>
+#include <string>
+#include <utility>
+#include <GL/glew.h>
+#include <pango/pangocairo.h>
+#include <cairo/cairo.h>
+
+#include "config.h"
+#include "glstate.h"
+#include "stream.h"
+#include "fonts.h"
+
+/**
+ * @brief Glyphs rasterized once with cairo and packed into a GL texture
+ */
+class PIXL_GlyphAtlas {
+	public:
+		typedef struct {
+			GLfloat s0, t0, s1, t1; // texture coordinates
+			int x, y; // offset from the pen position to the top left corner
+			int w, h; // 0 for glyphs without ink (spaces)
+		} Slot;
+
+		PIXL_GlyphAtlas(uint w=512, uint h=512);
+		virtual ~PIXL_GlyphAtlas();
+		int find(PangoFont* font, PangoGlyph glyph);
+		const Slot& getSlot(int i) { return slots[i]; }
+		GLuint getTexture() { return texture; }
+	private:
+		GLuint texture;
+		uint width;
+		uint height;
+		// shelf packing
+		uint pen_x;
+		uint pen_y;
+		uint shelf_h;
+		std::vector<Slot> slots;
+		std::map<std::pair<PangoFont*, PangoGlyph>, int> index;
+};
+
+
+/**
+ * @brief Text drawn as textured quads out of a glyph atlas
+ *
+ * Fast path for text that changes every frame (counters, debug info):
+ * instead of rasterizing into a PIXL_Layer that has to be uploaded as a
+ * whole, print() only appends one quad per glyph and draw() renders all the
+ * text printed since the last draw() with a single call. Shaping results are
+ * cached per string.
+ */
+class PIXL_TextRenderer {
+	public:
+		PIXL_TextRenderer(const char* f, uint s);
+		virtual ~PIXL_TextRenderer();
+		void setColor(float r, float g, float b, float a=1.f);
+		void print(const char* text, int x, int y);
+		void print(const char* text, const PIXL_Affine& m);
+		void draw();
+	private:
+		typedef struct {
+			int slot;
+			float x; // pen position relative to the top left of the text
+			float y;
+		} PlacedGlyph;
+
+		const std::vector<PlacedGlyph>& shape(const char* text);
+
+		PIXL_GlyphAtlas atlas;
+		PangoLayout* layout;
+		GLubyte color[4];
+		std::map<std::string, std::vector<PlacedGlyph> > cache;
+		std::vector<PIXL_Vertex> vertices; // copied to PIXL_stream by draw()
+};
+
+#endif // _PIXL_GLYPHS_H_
+
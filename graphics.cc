@@ -17,6 +17,12 @@
  */
 
 #include "graphics.h"
+#include "animations.h"
+#include "camera.h"
+#include "renderqueue.h"
+
+#include <string.h>
+#include <strings.h>
 
 /**
  * @brief Texture class constructor
@@ -28,53 +34,84 @@
 PIXL_Texture::PIXL_Texture(const GLvoid* d, const int w, const int h):data(d),width(w),height(h)
 {
 	glGenTextures(1, &texture);
-	glBindTexture(GL_TEXTURE_2D, texture);
+	PIXL_gl.bindTexture(texture);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA,
 				 GL_UNSIGNED_INT_8_8_8_8_REV, data);
 }
 
+PIXL_Texture::~PIXL_Texture()
+{
+	PIXL_gl.deleteTextures(1, &texture);
+}
+
 void PIXL_Texture::bind()
 {
-	glEnable(GL_TEXTURE_2D);
-	glBindTexture(GL_TEXTURE_2D, texture);
+	PIXL_gl.enable(GL_TEXTURE_2D);
+	PIXL_gl.bindTexture(texture);
 }
 
 void PIXL_Texture::unbind()
 {
-	glBindTexture(GL_TEXTURE_2D, 0);
-	glDisable(GL_TEXTURE_2D);
+	PIXL_gl.bindTexture(0);
+	PIXL_gl.disable(GL_TEXTURE_2D);
 }
 
 
 /**
  * @brief FBO class constructor
  */
-PIXL_FBO::PIXL_FBO()
+PIXL_FBO::PIXL_FBO(): width(0), height(0)
 {
 	shader = 0;
 
 	glGenFramebuffers(1, &fbo);
 	glGenTextures(1, &texture);
 
-	glBindTexture( GL_TEXTURE_2D, texture);
-	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST );
-	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
-	glTexImage2D( GL_TEXTURE_2D, 0, GL_RGBA, *PIXL_config.w, *PIXL_config.h, 0, GL_RGBA, GL_UNSIGNED_INT_8_8_8_8_REV, NULL);
+	allocate();
 
+	PIXL_gl.bindFramebuffer(fbo);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
 	if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
 		puts("FBO error");
+	PIXL_gl.bindFramebuffer(0);
 }
 
 PIXL_FBO::~PIXL_FBO()
 {
+	PIXL_gl.deleteTextures(1, &texture);
+	PIXL_gl.deleteFramebuffers(1, &fbo);
+}
+
+/**
+ * @brief (Re)allocate the texture at the render resolution
+ */
+void PIXL_FBO::allocate()
+{
+	generation = PIXL_config.getGeneration();
+	if(width == PIXL_config.getRenderWidth() && height == PIXL_config.getRenderHeight())
+		return;
+
+	width = PIXL_config.getRenderWidth();
+	height = PIXL_config.getRenderHeight();
+
+	PIXL_gl.bindTexture(texture);
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
+	glTexImage2D( GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_INT_8_8_8_8_REV, NULL);
 }
 
+/**
+ * @brief Render to the FBO, the game still draws in virtual coordinates
+ */
 void PIXL_FBO::bind()
 {
-	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+	if(generation != PIXL_config.getGeneration())
+		allocate();
+
+	PIXL_gl.bindFramebuffer(fbo);
+	PIXL_gl.viewport(0, 0, width, height);
 }
 
 /**
@@ -85,32 +122,50 @@ void PIXL_FBO::bind()
 void PIXL_FBO::draw(PIXL_FBO* target)
 {
 	if(shader)
-		glUseProgram(shader);
+		PIXL_gl.useProgram(shader);
 
 	if(target)
 		target->bind();
 	else
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-	glEnable(GL_TEXTURE_2D);
-	glBindTexture(GL_TEXTURE_2D, texture);
-	glBegin(GL_QUADS);
-		glTexCoord2f(0.0f, 1.0f); glVertex2i(0, 0);
-		glTexCoord2f(0.0f, 0.0f); glVertex2i(0, *PIXL_config.h);
-		glTexCoord2f(1.0f, 0.0f); glVertex2i(*PIXL_config.w, *PIXL_config.h);
-		glTexCoord2f(1.0f, 1.0f); glVertex2i(*PIXL_config.w, 0);
-	glEnd();
-	glDisable(GL_TEXTURE_2D);
+		PIXL_bindScreen();
+
+	PIXL_gl.enable(GL_TEXTURE_2D);
+	PIXL_gl.bindTexture(texture);
+	// upscaling to the window
+	GLint filter = PIXL_config.getUpscaling() == PIXL_config.integer && !target ? GL_NEAREST : GL_LINEAR;
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+	PIXL_stream.quad(0, 0, *PIXL_config.w, *PIXL_config.h, 0, 1, 1, 0);
 
 	if(shader)
-		glUseProgram(0);
+		PIXL_gl.useProgram(0);
 }
 
 
 /**
  * @brief Layer class constructor
+ *
+ * Without a size the layer covers the virtual resolution and follows its
+ * changes, the contents are lost then (see getClearCount()).
  */
-PIXL_Layer::PIXL_Layer(int w, int h): width(w), height(h)
+PIXL_Layer::PIXL_Layer(): width(*PIXL_config.w), height(*PIXL_config.h), follow(true)
+{
+	clear_count = 0;
+	allocate();
+}
+
+PIXL_Layer::PIXL_Layer(int w, int h): width(w), height(h), follow(false)
+{
+	clear_count = 0;
+	allocate();
+}
+
+PIXL_Layer::~PIXL_Layer()
+{
+	release();
+}
+
+void PIXL_Layer::allocate()
 {
 	sdlsurf = SDL_CreateRGBSurface( 0, width, height, 32,
 									CAIROSDL_RMASK,
@@ -122,59 +177,554 @@ PIXL_Layer::PIXL_Layer(int w, int h): width(w), height(h)
 
 	context = cairo_create(layer);
 
-	texture = new PIXL_Texture(getBuffer(), width, height);
+	texture = new PIXL_Texture(sdlsurf->pixels, width, height);
+
+	generation = PIXL_config.getGeneration();
+	invalidate();
 }
 
+void PIXL_Layer::release()
+{
+	delete texture;
+	cairo_destroy(context);
+	cairo_surface_destroy(layer);
+	SDL_FreeSurface(sdlsurf);
+}
+
+/**
+ * @brief Reallocate if the virtual resolution changed
+ */
+void PIXL_Layer::resize()
+{
+	generation = PIXL_config.getGeneration();
+	if(width == (int)*PIXL_config.w && height == (int)*PIXL_config.h)
+		return;
+
+	release();
+	width = *PIXL_config.w;
+	height = *PIXL_config.h;
+	allocate();
+	clear_count++; // like a clear(), PIXL_Text prints again
+}
+
+/**
+ * @brief Upload what changed since the last call and draw the layer
+ */
 void PIXL_Layer::draw()
 {
-	cairosdl_surface_flush(layer); 
-	glColor4f(1.f,1.f,1.f,1.f);
+	sync();
+	upload();
+	PIXL_stream.quad(0, 0, width, height, 0, 0, 1, 1);
+}
 
-	glEnable(GL_TEXTURE_2D);
-	glBindTexture( GL_TEXTURE_2D, texture->getId() );
-	glTexSubImage2D( GL_TEXTURE_2D, 0, 0, 0, width, height, GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV, texture->getData());
-	glBegin(GL_QUADS);
-		glTexCoord2f(0.0f, 0.0f); glVertex2i(0, 0);
-		glTexCoord2f(0.0f, 1.0f); glVertex2i(0, height);
-		glTexCoord2f(1.0f, 1.0f); glVertex2i(width, height);
-		glTexCoord2f(1.0f, 0.0f); glVertex2i(width, 0);
-	glEnd();
-	glDisable(GL_TEXTURE_2D);
+/**
+ * @brief Upload what changed and queue the layer
+ */
+void PIXL_Layer::draw(PIXL_RenderQueue* queue)
+{
+	sync();
+	upload();
+	queue->quad(texture->getId(), 0, 0, width, height);
+}
+
+void PIXL_Layer::upload()
+{
+	PIXL_gl.enable(GL_TEXTURE_2D);
+	PIXL_gl.bindTexture(texture->getId());
+	if(dirty.w && dirty.h) {
+		// only the dirty rectangle is unpremultiplied and uploaded
+		cairosdl_surface_flush_rect(layer, dirty.x, dirty.y, dirty.w, dirty.h);
+		glPixelStorei(GL_UNPACK_ROW_LENGTH, width);
+		glPixelStorei(GL_UNPACK_SKIP_PIXELS, dirty.x);
+		glPixelStorei(GL_UNPACK_SKIP_ROWS, dirty.y);
+		glTexSubImage2D( GL_TEXTURE_2D, 0, dirty.x, dirty.y, dirty.w, dirty.h, GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV, texture->getData());
+		glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+		glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+		glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
+		dirty.w = dirty.h = 0;
+	}
 }
 
 void PIXL_Layer::clear()
 {
+	sync();
+
 	cairo_save(context);
 	cairo_set_operator(context,CAIRO_OPERATOR_CLEAR);
 	cairo_paint(context);
 	cairo_restore(context);
+
+	clear_count++;
+	invalidate();
+}
+
+/**
+ * @brief Mark the whole layer to be uploaded on the next draw()
+ *
+ * @note Call it (or invalidate(SDL_Rect)) after drawing on getContext() directly
+ */
+void PIXL_Layer::invalidate()
+{
+	dirty.x = dirty.y = 0;
+	dirty.w = width;
+	dirty.h = height;
+}
+
+/**
+ * @brief Add a rectangle to the region uploaded on the next draw()
+ */
+void PIXL_Layer::invalidate(SDL_Rect r)
+{
+	// clip to the layer
+	int x0 = r.x < 0 ? 0 : r.x;
+	int y0 = r.y < 0 ? 0 : r.y;
+	int x1 = r.x + r.w > width ? width : r.x + r.w;
+	int y1 = r.y + r.h > height ? height : r.y + r.h;
+	if(x1 <= x0 || y1 <= y0)
+		return;
+
+	if(dirty.w && dirty.h) {
+		if(dirty.x < x0) x0 = dirty.x;
+		if(dirty.y < y0) y0 = dirty.y;
+		if(dirty.x + dirty.w > x1) x1 = dirty.x + dirty.w;
+		if(dirty.y + dirty.h > y1) y1 = dirty.y + dirty.h;
+	}
+
+	dirty.x = x0;
+	dirty.y = y0;
+	dirty.w = x1 - x0;
+	dirty.h = y1 - y0;
+}
+
+
+/**
+ * @brief Tiled layer constructor
+ *
+ * @param t tile size, 128 or 256 are good
+ * @param j render() paints the tiles in parallel, NULL for one by one
+ */
+PIXL_TiledLayer::PIXL_TiledLayer(uint t, PIXL_JobSystem* j): tile(t), cols(0), rows(0), cleared(false), jobs(j), allocated(0)
+{
+	generation = PIXL_config.getGeneration()-1; // build the grid on the first use
+}
+
+PIXL_TiledLayer::~PIXL_TiledLayer()
+{
+	for(uint i=0; i<tiles.size(); i++)
+		freeTile(i);
+}
+
+/**
+ * @brief Drop every tile if the virtual resolution changed
+ */
+void PIXL_TiledLayer::sync()
+{
+	if(generation == PIXL_config.getGeneration())
+		return;
+	generation = PIXL_config.getGeneration();
+
+	uint c = (*PIXL_config.w + tile-1) / tile;
+	uint r = (*PIXL_config.h + tile-1) / tile;
+	if(c == cols && r == rows)
+		return;
+
+	for(uint i=0; i<tiles.size(); i++)
+		freeTile(i);
+	cols = c;
+	rows = r;
+	tiles.assign(cols*rows, NULL);
+}
+
+void PIXL_TiledLayer::freeTile(uint i)
+{
+	Tile* t = tiles[i];
+	if(!t)
+		return;
+
+	delete t->texture;
+	cairo_surface_destroy(t->surface);
+	delete t;
+	tiles[i] = NULL;
+	allocated--;
 }
 
+/**
+ * @brief Record drawing for the next render()
+ *
+ * @param area what fn draws is clipped to it, only the tiles it touches are allocated
+ * @param fn draws with layer coordinates on the context it gets
+ */
+void PIXL_TiledLayer::paint(SDL_Rect area, const std::function<void(cairo_t*)>& fn)
+{
+	Command c;
+	c.area = area;
+	c.fn = fn;
+	commands.push_back(c);
+}
 
-PIXL_Image::PIXL_Image(PIXL_Layer* l, const char* f)
+/**
+ * @brief Paint what was recorded on the tiles it touches
+ */
+void PIXL_TiledLayer::render()
+{
+	sync();
+
+	for(uint i=0; i<commands.size(); i++) {
+		const SDL_Rect& a = commands[i].area;
+		int x0 = a.x < 0 ? 0 : a.x / (int)tile;
+		int y0 = a.y < 0 ? 0 : a.y / (int)tile;
+		int x1 = a.x + a.w <= 0 ? -1 : (a.x + a.w - 1) / (int)tile;
+		int y1 = a.y + a.h <= 0 ? -1 : (a.y + a.h - 1) / (int)tile;
+		if(x1 >= (int)cols) x1 = cols-1;
+		if(y1 >= (int)rows) y1 = rows-1;
+
+		for(int y=y0; y<=y1; y++) {
+			for(int x=x0; x<=x1; x++) {
+				Tile*& t = tiles[y*cols + x];
+				if(!t) {
+					t = new Tile;
+					t->surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, tile, tile);
+					t->texture = NULL;
+					t->changed = false;
+					allocated++;
+				}
+				t->commands.push_back(i);
+			}
+		}
+	}
+
+	PIXL_JobCounter counter;
+	for(uint i=0; i<tiles.size(); i++) {
+		Tile* t = tiles[i];
+		if(!t)
+			continue;
+
+		if(t->commands.empty()) {
+			// nothing painted on it since the clear, it's empty
+			if(cleared)
+				freeTile(i);
+			continue;
+		}
+
+		if(jobs)
+			jobs->run([this, i]() { paintTile(i); }, &counter);
+		else
+			paintTile(i);
+	}
+	if(jobs)
+		jobs->wait(&counter);
+
+	commands.clear();
+	cleared = false;
+}
+
+void PIXL_TiledLayer::paintTile(uint i)
+{
+	Tile* t = tiles[i];
+	cairo_t* context = cairo_create(t->surface);
+
+	if(cleared) {
+		cairo_set_operator(context, CAIRO_OPERATOR_CLEAR);
+		cairo_paint(context);
+		cairo_set_operator(context, CAIRO_OPERATOR_OVER);
+	}
+
+	cairo_translate(context, -(int)(i%cols*tile), -(int)(i/cols*tile));
+	for(uint j=0; j<t->commands.size(); j++) {
+		const Command& c = commands[t->commands[j]];
+		cairo_save(context);
+		cairo_rectangle(context, c.area.x, c.area.y, c.area.w, c.area.h);
+		cairo_clip(context);
+		c.fn(context);
+		cairo_restore(context);
+	}
+
+	cairo_destroy(context);
+	t->commands.clear();
+	t->changed = true;
+}
+
+void PIXL_TiledLayer::upload(Tile* t)
+{
+	if(!t->changed)
+		return;
+
+	cairo_surface_flush(t->surface);
+	// PIXL_Texture uploads as RGBA, cairo is BGRA in memory: always fill it
+	// below, like PIXL_Layer does after allocating
+	if(!t->texture)
+		t->texture = new PIXL_Texture(cairo_image_surface_get_data(t->surface), tile, tile);
+	PIXL_gl.bindTexture(t->texture->getId());
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, tile, tile, GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV, t->texture->getData());
+	t->changed = false;
+}
+
+/**
+ * @brief Upload the changed tiles and draw the allocated ones
+ */
+void PIXL_TiledLayer::draw()
+{
+	sync();
+
+	GLenum src, dst;
+	PIXL_gl.getBlendFunc(&src, &dst);
+	PIXL_gl.enable(GL_TEXTURE_2D);
+	PIXL_gl.blendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+	for(uint i=0; i<tiles.size(); i++) {
+		if(!tiles[i])
+			continue;
+		upload(tiles[i]);
+		PIXL_gl.bindTexture(tiles[i]->texture->getId());
+		float x = i%cols*tile;
+		float y = i/cols*tile;
+		PIXL_stream.quad(x, y, x+tile, y+tile, 0, 0, 1, 1);
+	}
+	PIXL_gl.blendFunc(src, dst);
+}
+
+/**
+ * @brief Upload the changed tiles and queue the allocated ones
+ */
+void PIXL_TiledLayer::draw(PIXL_RenderQueue* queue)
+{
+	sync();
+
+	const int blend = queue->getBlend();
+	queue->setBlend(PIXL_RenderQueue::premultiplied);
+	for(uint i=0; i<tiles.size(); i++) {
+		if(!tiles[i])
+			continue;
+		upload(tiles[i]);
+		float x = i%cols*tile;
+		float y = i/cols*tile;
+		queue->quad(tiles[i]->texture->getId(), x, y, x+tile, y+tile);
+	}
+	queue->setBlend(blend);
+}
+
+
+/**
+ * @brief Queue drawing for a layer, run() runs it on a worker
+ */
+void PIXL_LayerJobs::record(PIXL_Layer* layer, const std::function<void()>& fn)
+{
+	assert(!running); // the jobs would lose their task on a reallocation
+	for(uint i=0; i<tasks.size(); i++) {
+		if(tasks[i].layer == layer) {
+			tasks[i].fns.push_back(fn);
+			return;
+		}
+	}
+
+	Task t;
+	t.layer = layer;
+	t.fns.push_back(fn);
+	tasks.push_back(t);
+}
+
+/**
+ * @brief Start drawing every recorded layer, one job each
+ */
+void PIXL_LayerJobs::run()
+{
+	running = true;
+	for(uint i=0; i<tasks.size(); i++) {
+		// reallocating after a resolution change creates GL textures, do it here
+		tasks[i].layer->getContext();
+
+		Task* t = &tasks[i];
+		jobs->run([t]() {
+			for(uint j=0; j<t->fns.size(); j++)
+				t->fns[j]();
+		}, &counter);
+	}
+}
+
+/**
+ * @brief Wait for the layers, helping with the jobs meanwhile
+ */
+void PIXL_LayerJobs::wait()
+{
+	jobs->wait(&counter);
+	tasks.clear();
+	running = false;
+}
+
+
+/*
+ * Shared by every PIXL_Image
+ *
+ */
+PIXL_SVGCache PIXL_svgcache;
+
+/**
+ * @brief Get an SVG rasterized at (about) the given scale
+ *
+ * @param svg the loaded SVG
+ * @param file its file name, it is part of the key
+ * @param scale requested scale
+ * @param raster_scale set to the scale of the returned surface
+ *
+ * @return a new reference to the surface, cairo_surface_destroy() it after use
+ */
+cairo_surface_t* PIXL_SVGCache::get(RsvgHandle* svg, const std::string& file, float scale, float* raster_scale)
+{
+	int bucket = (int)floorf(scale*4 + 0.5f);
+	if(bucket < 1)
+		bucket = 1;
+	*raster_scale = bucket/4.f;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	Key key(file, bucket);
+	std::map<Key, std::list<Entry>::iterator>::iterator it = index.find(key);
+	if(it != index.end()) {
+		// move to the front
+		entries.splice(entries.begin(), entries, it->second);
+		return cairo_surface_reference(it->second->surface);
+	}
+
+	RsvgDimensionData size;
+	rsvg_handle_get_dimensions(svg, &size);
+	int w = (int)ceilf(size.width * *raster_scale);
+	int h = (int)ceilf(size.height * *raster_scale);
+
+	Entry entry;
+	entry.key = key;
+	entry.surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, w, h);
+	entry.bytes = cairo_image_surface_get_stride(entry.surface) * h;
+
+	cairo_t* cr = cairo_create(entry.surface);
+	cairo_scale(cr, *raster_scale, *raster_scale);
+	rsvg_handle_render_cairo(svg, cr);
+	cairo_destroy(cr);
+
+	evict(entry.bytes);
+	entries.push_front(entry);
+	index[key] = entries.begin();
+	used += entry.bytes;
+
+	return cairo_surface_reference(entry.surface);
+}
+
+/**
+ * @brief Drop least recently used rasters until there's room for bytes more
+ */
+void PIXL_SVGCache::evict(size_t bytes)
+{
+	while(!entries.empty() && used + bytes > capacity) {
+		Entry& last = entries.back();
+		used -= last.bytes;
+		index.erase(last.key);
+		cairo_surface_destroy(last.surface); // still alive if a cairo context uses it
+		entries.pop_back();
+	}
+}
+
+void PIXL_SVGCache::setCapacity(size_t bytes)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	capacity = bytes;
+	evict(0);
+}
+
+void PIXL_SVGCache::clear()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	std::list<Entry>::iterator it;
+	for(it=entries.begin(); it!=entries.end(); ++it)
+		cairo_surface_destroy(it->surface);
+	entries.clear();
+	index.clear();
+	used = 0;
+}
+
+
+/**
+ * @brief Image constructor
+ *
+ * @param l layer where it will be drawn
+ * @param f png or svg file (told apart by the extension)
+ */
+PIXL_Image::PIXL_Image(PIXL_Layer* l, const char* f): image(NULL), svg(NULL), file(f), width(0), height(0)
 {
 	layer = l;
-	image = cairo_image_surface_create_from_png(f);
+
+	if(file.size() > 4 && strcasecmp(file.c_str() + file.size() - 4, ".svg") == 0) {
+		GError* error = NULL;
+		svg = rsvg_handle_new_from_file(f, &error);
+		if(!svg) {
+			fprintf(stderr, "Error: svg %s: %s\n", f, error ? error->message : "");
+			if(error)
+				g_error_free(error);
+			return;
+		}
+
+		RsvgDimensionData size;
+		rsvg_handle_get_dimensions(svg, &size);
+		width = size.width;
+		height = size.height;
+	} else {
+		image = cairo_image_surface_create_from_png(f);
+		width = cairo_image_surface_get_width(image);
+		height = cairo_image_surface_get_height(image);
+	}
 }
 
 PIXL_Image::~PIXL_Image()
 {
-	cairo_surface_destroy(image);
+	if(image)
+		cairo_surface_destroy(image);
+	if(svg)
+		g_object_unref(svg);
 }
 
-void PIXL_Image::draw(int w=0, int h=0)
+/**
+ * @brief Draw the image on its layer
+ *
+ * @param w x-position
+ * @param h y-position
+ * @param scale svgs are rasterized at this scale (through PIXL_svgcache),
+ * pngs are just scaled
+ */
+void PIXL_Image::draw(int w=0, int h=0, float scale)
 {
-	cairo_set_source_surface(layer->getContext(), image, w, h);
-	cairo_paint(layer->getContext());
+	// out of the layer, skip the rasterization of svgs too
+	if(w >= layer->getWidth() || h >= layer->getHeight() || w + width*scale <= 0 || h + height*scale <= 0)
+		return;
+
+	cairo_t* context = layer->getContext();
+	cairo_surface_t* source = image;
+	float source_scale = 1.f;
+
+	if(svg)
+		source = PIXL_svgcache.get(svg, file, scale, &source_scale);
+	if(!source)
+		return;
+
+	if(scale == source_scale) {
+		cairo_set_source_surface(context, source, w, h);
+		cairo_paint(context);
+	} else {
+		cairo_save(context);
+		cairo_translate(context, w, h);
+		cairo_scale(context, scale/source_scale, scale/source_scale);
+		cairo_set_source_surface(context, source, 0, 0);
+		cairo_paint(context);
+		cairo_restore(context);
+	}
+	if(svg)
+		cairo_surface_destroy(source); // our reference from PIXL_svgcache
+
+	SDL_Rect r = { (Sint16)w, (Sint16)h, (Uint16)ceilf(width*scale), (Uint16)ceilf(height*scale) };
+	layer->invalidate(r);
 }
 
 
 PIXL_Sprite::PIXL_Sprite(const char* f)
 {
 		image = IMG_Load(f);
-		glEnable(GL_TEXTURE_2D);
 		glGenTextures(1, &texture);
-		glBindTexture(GL_TEXTURE_2D, texture);
+		PIXL_gl.bindTexture(texture);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 		// This could be better...
@@ -186,29 +736,50 @@ PIXL_Sprite::PIXL_Sprite(const char* f)
 				glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, image->w, image->h, 0, GL_RGBA, GL_UNSIGNED_INT_8_8_8_8_REV, image->pixels);
 				break;
 		}
-		glDisable(GL_TEXTURE_2D);
 }
 
 PIXL_Sprite::~PIXL_Sprite()
 {
 	SDL_FreeSurface(image);
-	glDeleteTextures(1, &texture);
+	PIXL_gl.deleteTextures(1, &texture);
 }
 
 void PIXL_Sprite::draw(int x, int y)
 {
-	glColor4f(1.f,1.f,1.f,1.f);
+	if(PIXL_cull(x, y, x+image->w, y+image->h))
+		return;
 
-	glEnable(GL_TEXTURE_2D);
-	glBindTexture( GL_TEXTURE_2D, texture );
+	PIXL_gl.enable(GL_TEXTURE_2D);
+	PIXL_gl.bindTexture(texture);
 	//glTexSubImage2D( GL_TEXTURE_2D, 0, 0, 0, image->w, image->h, GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV, image);
-	glBegin(GL_QUADS);
-		glTexCoord2f(0.0f, 0.0f); glVertex2i(x+0, y+0);
-		glTexCoord2f(0.0f, 1.0f); glVertex2i(x+0, y+image->h);
-		glTexCoord2f(1.0f, 1.0f); glVertex2i(x+image->w, y+image->h);
-		glTexCoord2f(1.0f, 0.0f); glVertex2i(x+image->w, y+0);
-	glEnd();
-	glDisable(GL_TEXTURE_2D);
+	PIXL_stream.quad(x, y, x+image->w, y+image->h, 0, 0, 1, 1);
+}
+
+void PIXL_Sprite::draw(PIXL_RenderQueue* queue, int x, int y)
+{
+	queue->quad(texture, x, y, x+image->w, y+image->h);
+}
+
+/**
+ * @brief Draw with a world transform, see PIXL_SceneGraph
+ *
+ * @param m the top left corner of the sprite is at its origin
+ */
+void PIXL_Sprite::draw(const PIXL_Affine& m)
+{
+	float x0, y0, x1, y1;
+	m.getBounds(image->w, image->h, &x0, &y0, &x1, &y1);
+	if(PIXL_cull(x0, y0, x1, y1))
+		return;
+
+	PIXL_gl.enable(GL_TEXTURE_2D);
+	PIXL_gl.bindTexture(texture);
+	PIXL_stream.quad(m, image->w, image->h, 0, 0, 1, 1);
+}
+
+void PIXL_Sprite::draw(PIXL_RenderQueue* queue, const PIXL_Affine& m)
+{
+	queue->quad(texture, m, image->w, image->h);
 }
 
 
@@ -218,102 +789,224 @@ PIXL_Animation::PIXL_Animation(const char* f, uint w, uint h, uint s): sprite_w(
 	m=0; // we start with the first frame
 	n=0; // and the first animation (just in case we try to draw without play() first)
 	assert(speed!=0); // speed can't be 0 because we divide by speed
-	start_time = SDL_GetTicks();
 	playing=false;
-	loop=false;
+	clips.resize(image->h/sprite_h, -1);
+	handle = PIXL_animations.add(getClip(0), false);
+	PIXL_animations.pause(handle);
 
-	glEnable(GL_TEXTURE_2D);
 	glGenTextures(1, &texture);
-	glBindTexture(GL_TEXTURE_2D, texture);
+	PIXL_gl.bindTexture(texture);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, image->w, image->h, 0, GL_RGBA, GL_UNSIGNED_INT_8_8_8_8_REV, image->pixels);
-	glDisable(GL_TEXTURE_2D);
 }
 
 PIXL_Animation::~PIXL_Animation()
 {
+	PIXL_animations.remove(handle);
 	SDL_FreeSurface(image);
-	glDeleteTextures(1, &texture);
+	PIXL_gl.deleteTextures(1, &texture);
+}
+
+/**
+ * @brief Clip of PIXL_animations for a row, added the first time it's played
+ */
+uint PIXL_Animation::getClip(uint row)
+{
+	if(row >= clips.size())
+		clips.resize(row+1, -1);
+	if(clips[row] < 0)
+		clips[row] = PIXL_animations.addClip(row, image->w/sprite_w, speed);
+
+	return clips[row];
+}
+
+/**
+ * @brief Read the frame from PIXL_animations, which advances it every tick
+ */
+void PIXL_Animation::update()
+{
+	m = PIXL_animations.getFrame(handle);
+	n = PIXL_animations.getRow(handle);
+	playing = PIXL_animations.isPlaying(handle);
 }
 
 void PIXL_Animation::draw(int x, int y)
 {
-	if(playing) {
-		int frames = image->w/(int)sprite_w; // amount of frames in 
-		if(loop) {
-			m = ((SDL_GetTicks()-start_time)/(int)speed) % frames; // the modulo is not necessary since textures already repeat, but we want to have m and n
-		} else {
-			m = (SDL_GetTicks()-start_time)/(int)speed;
-			if(m>=frames) {
-				// we reached the end...
-				m=frames-1;
-				playing = false;
-			}
-		}
-	}
+	if(PIXL_cull(x, y, x+sprite_w, y+sprite_h))
+		return;
+
+	update();
+
+	GLfloat vx = sprite_w/(float)image->w;
+	GLfloat vy = sprite_h/(float)image->h;
+
+	PIXL_gl.enable(GL_TEXTURE_2D);
+	PIXL_gl.bindTexture(texture);
+	PIXL_stream.quad(x, y, x+sprite_w, y+sprite_h, m*vx, n*vy, (m+1)*vx, (n+1)*vy);
+}
+
+void PIXL_Animation::draw(PIXL_RenderQueue* queue, int x, int y)
+{
+	update();
 
 	GLfloat vx = sprite_w/(float)image->w;
 	GLfloat vy = sprite_h/(float)image->h;
 
-	glColor4f(1.f,1.f,1.f,1.f);
+	queue->quad(texture, x, y, x+sprite_w, y+sprite_h, m*vx, n*vy, (m+1)*vx, (n+1)*vy);
+}
+
+void PIXL_Animation::draw(PIXL_RenderQueue* queue, const PIXL_Affine& world)
+{
+	update();
+
+	GLfloat vx = sprite_w/(float)image->w;
+	GLfloat vy = sprite_h/(float)image->h;
 
-	glEnable(GL_TEXTURE_2D);
-	glBindTexture( GL_TEXTURE_2D, texture );
-	glBegin(GL_QUADS);
-		glTexCoord2f(m*vx, n*vy); glVertex2i(x+0, y+0);
-		glTexCoord2f(m*vx, (n+1)*vy); glVertex2i(x+0, y+sprite_h);
-		glTexCoord2f((m+1)*vx, (n+1)*vy); glVertex2i(x+sprite_w, y+sprite_h);
-		glTexCoord2f((m+1)*vx, n*vy); glVertex2i(x+sprite_w, y+0);
-	glEnd();
-	glDisable(GL_TEXTURE_2D);
+	queue->quad(texture, world, sprite_w, sprite_h, m*vx, n*vy, (m+1)*vx, (n+1)*vy);
 }
 
 void PIXL_Animation::setSpeed(uint s)
 {
 	assert(s!=0);
-	speed = s;
+	// the clips keep the speed of the constructor, scale it
+	PIXL_animations.setSpeed(handle, speed/s);
 }
 
 void PIXL_Animation::play(uint new_n, bool l=false)
 {
 	// TODO check n
-	n = new_n;
+	PIXL_animations.play(handle, getClip(new_n), l);
 	playing = true;
-	loop = l;
-	start_time = SDL_GetTicks();
 }
 
 
-PIXL_Text::PIXL_Text(PIXL_Layer* l, const char* f, uint s, int x=0, int y=0): context(l->getContext()), font_name((const FcChar8*)f), font_size(s), pos_x(x), pos_y(y)
+PIXL_Text::PIXL_Text(PIXL_Layer* l, const char* f, uint s, int x=0, int y=0): layer(l), font_name(f), font_size(s), pos_x(x), pos_y(y)
 {
-	fc = FcConfigGetCurrent(); //para checkear si existe fuente
-	blanks = FcBlanksCreate(); //para errores de fuentes
-	count = 0;
-	if(!FcConfigAppFontAddFile(fc, font_name)) {
-		printf("ERROR FontConfig!\n");
-	}
-	pattern = FcFreeTypeQuery(font_name , 0, blanks, &count); //obtengo el pattern
-
-	layout = pango_cairo_create_layout(context); //creo layout de pango para el texto
-	font_description = pango_fc_font_description_from_pattern(pattern, 0); //le paso el pattern a pango
-
-	pango_font_description_set_size(font_description, font_size*PANGO_SCALE); //seteo tamanio de la fuente
-	pango_layout_set_font_description(layout, font_description); //seteo la fuente a usar en el layout
+	std::lock_guard<std::recursive_mutex> lock(PIXL_fonts.getMutex());
+	layout = pango_layout_new(PIXL_fonts.getContext(f, s)); //creo layout de pango para el texto
+	hash = 0;
+	clear_count = layer->getClearCount();
+	bounds.x = bounds.y = bounds.w = bounds.h = 0;
+	dirty = bounds;
+	under = NULL;
 }
 
 PIXL_Text::~PIXL_Text(){
+	if(under)
+		cairo_surface_destroy(under);
+	std::lock_guard<std::recursive_mutex> lock(PIXL_fonts.getMutex());
 	g_object_unref(layout);
-	pango_font_description_free(font_description);
 }
 
+void PIXL_Text::setSize(uint s)
+{
+	font_size = s;
+	std::lock_guard<std::recursive_mutex> lock(PIXL_fonts.getMutex());
+	pango_layout_set_font_description(layout, PIXL_fonts.getDescription(font_name.c_str(), font_size));
+}
+
+/**
+ * @brief FNV-1a, to tell if the text changed without keeping a copy
+ */
+static uint64_t hash_bytes(const void* data, size_t n, uint64_t h=14695981039346656037ULL)
+{
+	const unsigned char* p = (const unsigned char*)data;
+	for(size_t i=0; i<n; i++) {
+		h ^= p[i];
+		h *= 1099511628211ULL;
+	}
+	return h;
+}
+
+/**
+ * @brief Print text on the layer
+ *
+ * If the text, font and position are the same as in the last call (and the
+ * layer wasn't cleared meanwhile) nothing is laid out nor drawn. Otherwise
+ * the old text is erased, putting back the pixels it covered, and only the
+ * affected area is marked dirty in the layer, see getDirtyRect().
+ */
 void PIXL_Text::print(const char* text){
-	cairo_move_to(context, pos_x, pos_y);
+	cairo_t* context = layer->getContext(); // may change with the resolution
+	uint64_t h = hash_bytes(text, strlen(text));
+	h = hash_bytes(font_name.c_str(), font_name.size(), h);
+	h = hash_bytes(&font_size, sizeof(font_size), h);
+	h = hash_bytes(&pos_x, sizeof(pos_x), h);
+	h = hash_bytes(&pos_y, sizeof(pos_y), h);
+
+	if(h == hash && clear_count == layer->getClearCount()) {
+		dirty.w = dirty.h = 0;
+		return;
+	}
+
+	PangoRectangle ink, logical;
+	{
+		std::lock_guard<std::recursive_mutex> lock(PIXL_fonts.getMutex());
+		pango_layout_set_text(layout, text, -1);
+		pango_layout_get_pixel_extents(layout, &ink, &logical);
+	}
 
-	cairo_set_source_rgba(context, 1, 1, 1, 1);
-	pango_cairo_show_layout(context, layout);
+	// erase what we printed before by putting back what was under it,
+	// unless the layer has been cleared and that is gone anyway
+	if(under) {
+		if(clear_count == layer->getClearCount()) {
+			cairo_save(context);
+			cairo_set_operator(context, CAIRO_OPERATOR_SOURCE);
+			cairo_set_source_surface(context, under, bounds.x, bounds.y);
+			cairo_rectangle(context, bounds.x, bounds.y, bounds.w, bounds.h);
+			cairo_fill(context);
+			cairo_restore(context);
+		}
+		cairo_surface_destroy(under);
+		under = NULL;
+	}
+	dirty = bounds;
+
+	int x0 = ink.x < logical.x ? ink.x : logical.x;
+	int y0 = ink.y < logical.y ? ink.y : logical.y;
+	int x1 = ink.x + ink.width > logical.x + logical.width ? ink.x + ink.width : logical.x + logical.width;
+	int y1 = ink.y + ink.height > logical.y + logical.height ? ink.y + ink.height : logical.y + logical.height;
+	bounds.x = pos_x + x0;
+	bounds.y = pos_y + y0;
+	bounds.w = x1 - x0;
+	bounds.h = y1 - y0;
+
+	// keep what the new text covers, for the next print()
+	if(bounds.w && bounds.h) {
+		under = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, bounds.w, bounds.h);
+		cairo_t* cr = cairo_create(under);
+		cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
+		cairo_set_source_surface(cr, cairo_get_target(context), -bounds.x, -bounds.y);
+		cairo_paint(cr);
+		cairo_destroy(cr);
+	}
+
+	{
+		std::lock_guard<std::recursive_mutex> lock(PIXL_fonts.getMutex());
+		cairo_move_to(context, pos_x, pos_y);
+		cairo_set_source_rgba(context, 1, 1, 1, 1);
+		pango_cairo_show_layout(context, layout);
+	}
+
+	layer->invalidate(dirty);
+	layer->invalidate(bounds);
+
+	// report the union of the old and new areas
+	if(dirty.w && dirty.h) {
+		x0 = dirty.x < bounds.x ? dirty.x : bounds.x;
+		y0 = dirty.y < bounds.y ? dirty.y : bounds.y;
+		x1 = dirty.x + dirty.w > bounds.x + bounds.w ? dirty.x + dirty.w : bounds.x + bounds.w;
+		y1 = dirty.y + dirty.h > bounds.y + bounds.h ? dirty.y + dirty.h : bounds.y + bounds.h;
+		dirty.x = x0;
+		dirty.y = y0;
+		dirty.w = x1 - x0;
+		dirty.h = y1 - y0;
+	} else {
+		dirty = bounds;
+	}
 
-	pango_layout_set_text(layout, text, -1);
-	cairo_fill(context);
+	hash = h;
+	clear_count = layer->getClearCount();
 }
 
@@ -16,11 +16,21 @@
  * 
  */
 
+#ifndef _PIXL_GRAPHICS_H_
+#define _PIXL_GRAPHICS_H_
+
 #include <iostream>
 #include <fstream>
 #include <sstream>
 #include <string>
+#include <list>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <functional>
+#include <utility>
 #include <cmath>
+#include <stdint.h>
 #include <assert.h>
 #include <GL/glew.h>
 #include <GL/glxew.h>
@@ -34,6 +44,11 @@
 #include <librsvg/rsvg.h>
 
 #include "config.h"
+#include "glstate.h"
+#include "stream.h"
+#include "fonts.h"
+#include "jobs.h"
+#include "arena.h"
 
 typedef unsigned int uint;
 
@@ -58,6 +73,9 @@ class PIXL_Texture {
 };
 
 
+class PIXL_RenderQueue;
+
+
 /**
  * @brief Framebuffer object
  *
@@ -69,11 +87,16 @@ class PIXL_FBO {
 		virtual ~PIXL_FBO();
 		void bind();
 		void draw(PIXL_FBO* target=NULL);
+		GLuint getTexture() { return texture; }
 		GLuint shader;
 	private:
 		//PIXL_Texture *texture;
+		void allocate();
 		GLuint fbo;
 		GLuint texture;
+		uint width; // follows the render resolution of PIXL_config
+		uint height;
+		uint generation; // of PIXL_config when allocated
 };
 
 
@@ -82,24 +105,164 @@ class PIXL_FBO {
  */
 class PIXL_Layer {
 	public:
+		PIXL_Layer();
 		PIXL_Layer(int w, int h);
 		~PIXL_Layer();
-		int getWidth() { return width; }
-		int getHeight() { return height; }
-		cairo_t* getContext() { return context; }
-		void* getBuffer() { return sdlsurf->pixels; }
+		int getWidth() { sync(); return width; }
+		int getHeight() { sync(); return height; }
+		cairo_t* getContext() { sync(); return context; }
+		void* getBuffer() { sync(); return sdlsurf->pixels; }
 		void draw();
+		void draw(PIXL_RenderQueue* queue);
 		void clear();
+		void invalidate();
+		void invalidate(SDL_Rect r);
+		SDL_Rect getDirtyRect() { return dirty; }
+		uint getClearCount() { return clear_count; }
 	private:
+		void sync() { if(follow && generation != PIXL_config.getGeneration()) resize(); }
+		void upload();
+		void resize();
+		void allocate();
+		void release();
 		SDL_Surface *sdlsurf;
 		cairo_surface_t *layer;
 		cairo_t* context;
 		PIXL_Texture* texture;
 		int width;
 		int height;
+		SDL_Rect dirty; // region to upload on the next draw(), empty if w or h are 0
+		uint clear_count;
+		bool follow; // sized to the virtual resolution
+		uint generation; // of PIXL_config when allocated
+};
+
+
+/**
+ * @brief Sparse cairo layer made of square tiles
+ *
+ * Covers the virtual resolution like PIXL_Layer(), but only the tiles
+ * something is painted on are allocated. paint() records a function
+ * drawing inside an area, render() runs the functions of every touched
+ * tile, each tile on its own job and clipped to the area, and draw()
+ * uploads the changed tiles and draws the allocated ones. clear() frees
+ * the tiles nothing is painted on again before the next render().
+ *
+ * A function spanning several tiles runs once per tile, maybe at the same
+ * time on different threads, so it may only draw on the context it gets
+ * (Pango calls have to hold PIXL_fonts.getMutex()). Tiles are kept
+ * premultiplied, they are blended with PIXL_RenderQueue::premultiplied.
+ */
+class PIXL_TiledLayer {
+	public:
+		PIXL_TiledLayer(uint t=128, PIXL_JobSystem* j=NULL);
+		~PIXL_TiledLayer();
+		void paint(SDL_Rect area, const std::function<void(cairo_t*)>& fn);
+		void clear() { cleared = true; }
+		void render();
+		void draw();
+		void draw(PIXL_RenderQueue* queue);
+		uint getTileCount() { return allocated; }
+		size_t getBytes() { return (size_t)allocated*tile*tile*4; }
+	private:
+		typedef struct {
+			cairo_surface_t* surface;
+			PIXL_Texture* texture; // created on the first upload
+			bool changed; // since the last upload
+			std::vector<uint> commands; // to paint in render()
+		} Tile;
+
+		typedef struct {
+			SDL_Rect area;
+			std::function<void(cairo_t*)> fn;
+		} Command;
+
+		void sync();
+		void paintTile(uint i);
+		void upload(Tile* t);
+		void freeTile(uint i);
+
+		uint tile; // size in pixels
+		uint cols;
+		uint rows;
+		std::vector<Tile*> tiles; // NULL if not allocated
+		std::vector<Command> commands; // since the last render()
+		bool cleared; // since the last render()
+		PIXL_JobSystem* jobs;
+		uint allocated;
+		uint generation; // of PIXL_config the grid was made for
 };
 
 
+/**
+ * @brief Draws several layers at the same time on the job system
+ *
+ * record() queues drawing on a layer (images, texts, cairo calls on its
+ * context) and run() starts one job per layer, which runs what was
+ * recorded for it in order. After wait() the layers are drawn as usual,
+ * only their upload happens on the GL thread. Between run() and wait()
+ * nothing else may touch the recorded layers, record() asserts it isn't
+ * called then since the running jobs point into the tasks, and the functions of
+ * different layers may not share objects other than PIXL_svgcache and
+ * PIXL_fonts, which lock themselves. What is recorded is kept in the
+ * PIXL_FrameArena, so wait() has to come before the end of the frame.
+ */
+class PIXL_LayerJobs {
+	public:
+		PIXL_LayerJobs(PIXL_JobSystem* j): jobs(j), running(false) {}
+		void record(PIXL_Layer* layer, const std::function<void()>& fn);
+		void run();
+		void wait();
+		uint getLayerCount() { return tasks.size(); }
+	private:
+		typedef struct {
+			PIXL_Layer* layer;
+			PIXL_FrameVector<std::function<void()> > fns; // recorded this frame
+		} Task;
+
+		PIXL_JobSystem* jobs;
+		std::vector<Task> tasks; // one per layer, kept until wait()
+		PIXL_JobCounter counter;
+		bool running; // between run() and wait()
+};
+
+
+/**
+ * @brief LRU cache of rasterized SVGs, keyed by file and scale bucket
+ *
+ * Scales are rounded to the nearest 1/4, so an SVG drawn at slightly
+ * different scales is rasterized only once per bucket. It can be used
+ * from several threads, get() returns a reference so eviction by another
+ * thread doesn't free a surface in use.
+ */
+class PIXL_SVGCache {
+	public:
+		PIXL_SVGCache(size_t bytes = 32*1024*1024): capacity(bytes), used(0) {}
+		~PIXL_SVGCache() { clear(); }
+		cairo_surface_t* get(RsvgHandle* svg, const std::string& file, float scale, float* raster_scale);
+		void setCapacity(size_t bytes);
+		size_t getUsed() { return used; }
+		void clear();
+	private:
+		typedef std::pair<std::string, int> Key;
+		typedef struct {
+			Key key;
+			cairo_surface_t* surface;
+			size_t bytes;
+		} Entry;
+
+		void evict(size_t bytes);
+
+		size_t capacity;
+		size_t used;
+		std::list<Entry> entries; // most recently used first
+		std::map<Key, std::list<Entry>::iterator> index;
+		std::mutex mutex;
+};
+
+extern PIXL_SVGCache PIXL_svgcache;
+
+
 /**
  * @brief Image class for Layers (png and svg )
  */
@@ -107,9 +270,15 @@ class PIXL_Image {
 	public:
 		PIXL_Image(PIXL_Layer* l, const char* f);
 		virtual ~PIXL_Image();
-		void draw(int w, int h);
+		void draw(int w, int h, float scale=1.f);
+		int getWidth() { return width; }
+		int getHeight() { return height; }
 	private:
-		cairo_surface_t* image;
+		cairo_surface_t* image; // NULL for svg
+		RsvgHandle* svg; // NULL for png
+		std::string file;
+		int width;
+		int height;
 		PIXL_Layer* layer;
 };
 
@@ -122,6 +291,9 @@ class PIXL_Sprite {
 		PIXL_Sprite(const char* f);
 		virtual ~PIXL_Sprite();
 		void draw(int x, int y);
+		void draw(PIXL_RenderQueue* queue, int x, int y);
+		void draw(const PIXL_Affine& m);
+		void draw(PIXL_RenderQueue* queue, const PIXL_Affine& m);
 	private:
 		SDL_Surface* image;
 		GLuint texture;
@@ -136,10 +308,14 @@ class PIXL_Animation {
 		PIXL_Animation(const char* f, uint w, uint h, uint s);
 		virtual ~PIXL_Animation();
 		void draw(int x, int y);
+		void draw(PIXL_RenderQueue* queue, int x, int y);
+		void draw(PIXL_RenderQueue* queue, const PIXL_Affine& world);
 		void setSpeed(uint s);
 		void play(uint new_n, bool l);
 		bool isPlaying() { return playing; }
 	private:
+		void update();
+		uint getClip(uint row);
 		SDL_Surface* image;
 		GLuint texture;
 		uint sprite_w; // width of one single sprite
@@ -147,33 +323,42 @@ class PIXL_Animation {
 		uint m; // frame number, or column
 		uint n; // animation number, or row
 		float speed; // duration of each frame in ms
-		uint start_time;
 		bool playing;
-		bool loop;
+		uint handle; // in PIXL_animations
+		std::vector<int> clips; // of PIXL_animations, for every row
 };
 
 
 /**
  * @brief Text rendering class
+ *
+ * print() only redraws when the text changed. It keeps a copy of the
+ * layer pixels under the text and erases the old text by putting them
+ * back, so texts can share a layer with other drawings. Whatever is drawn
+ * over the text after print() is undone there by the next print() though,
+ * draw the text last.
  */
 class PIXL_Text {
 	public:
 		PIXL_Text(PIXL_Layer* l, const char* f, uint s, int x, int y);
 		virtual ~PIXL_Text();
-		void setSize(uint s) { font_size=s; }
+		void setSize(uint s);
 		void setPos(int x, int y) { pos_x=x; pos_y=y; };
 		void print(const char* text);
+		SDL_Rect getDirtyRect() { return dirty; }
 	private:
-		const FcChar8 *font_name;
+		PIXL_Layer* layer;
+		std::string font_name;
 		uint font_size;
 		int pos_x;
 		int pos_y;
-		FcConfig *fc; //para checkear si existe fuente
-		FcBlanks *blanks; //para errores de fuentes
-		FcPattern *pattern;
-		cairo_t* context; 
-		PangoLayout *layout;
-		PangoFontDescription *font_description;
-		int count;
+		PangoLayout *layout; // fonts and Pango context are shared, see PIXL_FontRegistry
+		uint64_t hash; // of what was printed last time
+		uint clear_count; // of the layer when we printed
+		SDL_Rect bounds; // of what was printed last time
+		SDL_Rect dirty; // area changed by the last print()
+		cairo_surface_t* under; // layer pixels below bounds, NULL if none
 };
 
+#endif // _PIXL_GRAPHICS_H_
+
@@ -0,0 +1,240 @@
+/* 
+ * Copyright (C) 2012 - Brian Gomes Bascoy
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ * 
+ */
+
+#include "jobs.h"
+
+// which scheduler and deque the current thread belongs to
+static thread_local PIXL_JobSystem* current_system = NULL;
+static thread_local uint current_queue = 0;
+
+/**
+ * @brief Job scheduler constructor
+ *
+ * @param threads amount of worker threads, -1 for one less than the cores
+ */
+PIXL_JobSystem::PIXL_JobSystem(int threads_n): pending(0), quit(false)
+{
+	if(threads_n < 0) {
+		threads_n = std::thread::hardware_concurrency() - 1;
+		if(threads_n < 0)
+			threads_n = 0;
+	}
+
+	for(int i=0; i<=threads_n; i++)
+		queues.push_back(new Queue);
+
+	current_system = this;
+	current_queue = 0;
+
+	for(int i=1; i<=threads_n; i++)
+		threads.push_back(std::thread(&PIXL_JobSystem::worker, this, i));
+}
+
+PIXL_JobSystem::~PIXL_JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(sleep_mutex);
+		quit = true;
+	}
+	wake.notify_all();
+
+	for(uint i=0; i<threads.size(); i++)
+		threads[i].join();
+
+	for(uint i=0; i<queues.size(); i++)
+		delete queues[i];
+
+	if(current_system == this)
+		current_system = NULL;
+}
+
+uint PIXL_JobSystem::currentQueue()
+{
+	// threads that are not ours share the queue of the main thread
+	return current_system == this ? current_queue : 0;
+}
+
+void PIXL_JobSystem::push(uint q, const Job& job)
+{
+	{
+		std::lock_guard<std::mutex> lock(queues[q]->mutex);
+		queues[q]->jobs.push_back(job);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(sleep_mutex);
+		pending++;
+	}
+	wake.notify_one();
+}
+
+/**
+ * @brief Pop from our own deque or steal from someone else
+ */
+bool PIXL_JobSystem::take(uint q, Job* job)
+{
+	{
+		std::lock_guard<std::mutex> lock(queues[q]->mutex);
+		if(!queues[q]->jobs.empty()) {
+			*job = queues[q]->jobs.back();
+			queues[q]->jobs.pop_back();
+			pending--;
+			return true;
+		}
+	}
+
+	for(uint i=1; i<queues.size(); i++) {
+		Queue* victim = queues[(q+i) % queues.size()];
+		std::lock_guard<std::mutex> lock(victim->mutex);
+		if(!victim->jobs.empty()) {
+			*job = victim->jobs.front();
+			victim->jobs.pop_front();
+			pending--;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/**
+ * @brief Run a single job if there is one ready
+ *
+ * @return false if there was nothing to do
+ */
+bool PIXL_JobSystem::runOne(uint q)
+{
+	Job job;
+	if(!take(q, &job))
+		return false;
+
+	if(job.dependency) {
+		// not ready yet, park it until the job finishing the dependency
+		// calls unpark(), checked under the lock so that can't be missed
+		std::lock_guard<std::mutex> lock(park_mutex);
+		if(!job.dependency->done()) {
+			parked.push_back(job);
+			return true;
+		}
+	}
+
+	job.fn();
+
+	// the counter may be gone once it reaches 0, only its address is used
+	PIXL_JobCounter* counter = job.counter;
+	if(counter && counter->add(-1) == 0)
+		unpark(q, counter);
+
+	return true;
+}
+
+/**
+ * @brief Queue again the parked jobs that depend on a finished counter
+ */
+void PIXL_JobSystem::unpark(uint q, const PIXL_JobCounter* counter)
+{
+	std::vector<Job> ready;
+	{
+		std::lock_guard<std::mutex> lock(park_mutex);
+		for(uint i=0; i<parked.size(); ) {
+			if(parked[i].dependency == counter) {
+				ready.push_back(parked[i]);
+				parked[i] = parked.back();
+				parked.pop_back();
+			} else {
+				i++;
+			}
+		}
+	}
+
+	for(uint i=0; i<ready.size(); i++)
+		push(q, ready[i]);
+}
+
+void PIXL_JobSystem::worker(uint q)
+{
+	current_system = this;
+	current_queue = q;
+
+	while(!quit) {
+		if(runOne(q))
+			continue;
+
+		std::unique_lock<std::mutex> lock(sleep_mutex);
+		wake.wait(lock, [this]{ return quit || pending > 0; });
+	}
+}
+
+/**
+ * @brief Schedule a job
+ *
+ * @param job what to run
+ * @param counter incremented now and decremented when the job finishes
+ * @param dependency the job won't start until this counter reaches 0, it
+ * must count jobs of this scheduler since those wake the job up
+ */
+void PIXL_JobSystem::run(const std::function<void()>& job, PIXL_JobCounter* counter, const PIXL_JobCounter* dependency)
+{
+	Job j;
+	j.fn = job;
+	j.counter = counter;
+	j.dependency = dependency;
+
+	if(counter)
+		counter->add(1);
+
+	push(currentQueue(), j);
+}
+
+/**
+ * @brief Split [begin, end) in chunks of grain elements and run them as jobs
+ *
+ * @param job called with the [first, last) range of each chunk
+ * @param counter if NULL the call waits for all the chunks, otherwise it
+ * returns right away and the chunks are added to the counter
+ */
+void PIXL_JobSystem::parallelFor(uint begin, uint end, uint grain, const std::function<void(uint, uint)>& job, PIXL_JobCounter* counter)
+{
+	PIXL_JobCounter local;
+	PIXL_JobCounter* c = counter ? counter : &local;
+
+	if(grain == 0)
+		grain = 1;
+
+	for(uint first=begin; first<end; first+=grain) {
+		uint last = end - first > grain ? first + grain : end;
+		run(std::bind(job, first, last), c);
+	}
+
+	if(!counter)
+		wait(&local);
+}
+
+/**
+ * @brief Wait for a counter to reach 0, running jobs meanwhile
+ */
+void PIXL_JobSystem::wait(const PIXL_JobCounter* counter)
+{
+	uint q = currentQueue();
+
+	while(!counter->done()) {
+		if(!runOne(q))
+			std::this_thread::yield();
+	}
+}
+
@@ -0,0 +1,102 @@
+/* 
+ * Copyright (C) 2012 - Brian Gomes Bascoy
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ * 
+ */
+
+#ifndef _PIXL_JOBS_H_
+#define _PIXL_JOBS_H_
+
+#include <vector>
+#include <deque>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <functional>
+
+#include "config.h"
+
+/**
+ * @brief Amount of unfinished jobs of a group
+ */
+class PIXL_JobCounter {
+	public:
+		PIXL_JobCounter(): value(0) {}
+		bool done() const { return value.load(std::memory_order_acquire) == 0; }
+		int get() const { return value.load(std::memory_order_acquire); }
+		int add(int n) { return value.fetch_add(n, std::memory_order_acq_rel) + n; }
+	private:
+		PIXL_JobCounter(const PIXL_JobCounter&);
+		PIXL_JobCounter& operator=(const PIXL_JobCounter&);
+		std::atomic<int> value;
+};
+
+
+/**
+ * @brief Work stealing job scheduler
+ *
+ * Every thread has its own deque: jobs are pushed and popped at the back by
+ * their owner and stolen from the front by the others. The thread that
+ * created the scheduler (usually the main one) owns deque 0 and only runs
+ * jobs while it is inside wait(), so it helps instead of blocking.
+ *
+ * Jobs taken before their dependency is done are parked aside and only go
+ * back to a deque when its counter reaches 0.
+ *
+ * @note With 0 worker threads everything runs inside wait().
+ */
+class PIXL_JobSystem {
+	public:
+		PIXL_JobSystem(int threads=-1);
+		~PIXL_JobSystem();
+		void run(const std::function<void()>& job, PIXL_JobCounter* counter=NULL, const PIXL_JobCounter* dependency=NULL);
+		void parallelFor(uint begin, uint end, uint grain, const std::function<void(uint, uint)>& job, PIXL_JobCounter* counter=NULL);
+		void wait(const PIXL_JobCounter* counter);
+		uint getThreadCount() { return threads.size(); }
+	private:
+		typedef struct {
+			std::function<void()> fn;
+			PIXL_JobCounter* counter; // decremented when fn returns
+			const PIXL_JobCounter* dependency; // fn doesn't start before it reaches 0
+		} Job;
+
+		typedef struct {
+			std::mutex mutex;
+			std::deque<Job> jobs;
+		} Queue;
+
+		PIXL_JobSystem(const PIXL_JobSystem&);
+		PIXL_JobSystem& operator=(const PIXL_JobSystem&);
+
+		uint currentQueue();
+		void push(uint q, const Job& job);
+		bool take(uint q, Job* job);
+		bool runOne(uint q);
+		void unpark(uint q, const PIXL_JobCounter* counter);
+		void worker(uint q);
+
+		std::vector<Queue*> queues; // queue 0 belongs to the creating thread
+		std::vector<std::thread> threads;
+		std::atomic<int> pending; // jobs sitting in the queues
+		std::atomic<bool> quit;
+		std::mutex park_mutex;
+		std::vector<Job> parked; // waiting for their dependency
+		std::mutex sleep_mutex;
+		std::condition_variable wake;
+};
+
+#endif // _PIXL_JOBS_H_
+
@@ -0,0 +1,44 @@
+/* 
+ * Copyright (C) 2012 - Brian Gomes Bascoy
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ * 
+ */
+
+#ifndef _PIXL_MAP_H_
+#define _PIXL_MAP_H_
+
+#include <vector>
+#include <string>
+
+#include "config.h"
+
+typedef struct {
+	unsigned int w;
+	unsigned int h;
+} PIXL_T_size;
+
+/**
+ * @brief Tile map as loaded from a .tmx file
+ */
+typedef struct {
+	std::vector<int> tile; // tile number starting from 1
+	PIXL_T_size tile_size; // in pixels
+	std::string tileset_file; // atlas file name
+	PIXL_T_size tileset_size; // in tiles
+	PIXL_T_size size; // in tiles
+} PIXL_T_map;
+
+#endif // _PIXL_MAP_H_
+
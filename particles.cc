@@ -0,0 +1,225 @@
+/* 
+ * Copyright (C) 2012 - Brian Gomes Bascoy
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ * 
+ */
+
+#include "particles.h"
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <cmath>
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
+static float random_range(float min, float max)
+{
+	return min + (max-min)*(rand()/(float)RAND_MAX);
+}
+
+/**
+ * @brief Particle system constructor
+ *
+ * @param f texture of the particles (png)
+ * @param max maximum amount of live particles
+ */
+PIXL_ParticleSystem::PIXL_ParticleSystem(const char* f, uint max): gravity_x(0), gravity_y(0), max_particles(max), count(0)
+{
+	image = IMG_Load(f);
+	texture = new PIXL_Texture(image->pixels, image->w, image->h);
+
+	uint padded = (max + 3) & ~3u;
+	pos_x.resize(padded, 0);
+	pos_y.resize(padded, 0);
+	vel_x.resize(padded, 0);
+	vel_y.resize(padded, 0);
+	life.resize(padded, 0);
+	inv_life.resize(padded, 0);
+}
+
+PIXL_ParticleSystem::~PIXL_ParticleSystem()
+{
+	delete texture;
+	SDL_FreeSurface(image);
+}
+
+/**
+ * @brief Add a continuous emitter
+ *
+ * @param x position
+ * @param y position
+ * @param rate particles per second
+ * @param l life of each particle in seconds
+ *
+ * @return emitter index, see getEmitter() to tune the rest of its settings.
+ * Keep the index rather than that pointer, the next addEmitter() may move
+ * the emitters.
+ */
+uint PIXL_ParticleSystem::addEmitter(float x, float y, float rate, float l)
+{
+	PIXL_Emitter e;
+	e.x = x;
+	e.y = y;
+	e.rate = rate;
+	e.life = l;
+	e.angle = -M_PI/2;
+	e.spread = M_PI/8;
+	e.speed_min = 50;
+	e.speed_max = 100;
+	e.active = true;
+	e.accumulator = 0;
+	emitters.push_back(e);
+
+	return emitters.size()-1;
+}
+
+/**
+ * @brief Spawn a single particle
+ *
+ * @return false if the system is full
+ */
+bool PIXL_ParticleSystem::emit(float x, float y, float vx, float vy, float l)
+{
+	if(count >= max_particles || l <= 0)
+		return false;
+
+	pos_x[count] = x;
+	pos_y[count] = y;
+	vel_x[count] = vx;
+	vel_y[count] = vy;
+	life[count] = l;
+	inv_life[count] = 1.f/l;
+	count++;
+
+	return true;
+}
+
+/**
+ * @brief Spawn, move and kill particles
+ *
+ * @param dt elapsed time in seconds
+ */
+void PIXL_ParticleSystem::update(float dt)
+{
+	for(uint i=0; i<emitters.size(); i++) {
+		PIXL_Emitter& e = emitters[i];
+		if(!e.active)
+			continue;
+
+		e.accumulator += e.rate*dt;
+		while(e.accumulator >= 1) {
+			float a = e.angle + random_range(-e.spread, e.spread);
+			float v = random_range(e.speed_min, e.speed_max);
+			emit(e.x, e.y, cosf(a)*v, sinf(a)*v, e.life);
+			e.accumulator -= 1;
+		}
+	}
+
+	integrate(dt);
+	compact();
+}
+
+void PIXL_ParticleSystem::integrate(float dt)
+{
+	const float gx = gravity_x*dt;
+	const float gy = gravity_y*dt;
+	uint i = 0;
+
+#ifdef __SSE__
+	// arrays are padded to a multiple of 4, so the last group can go past count
+	const __m128 vdt = _mm_set1_ps(dt);
+	const __m128 vgx = _mm_set1_ps(gx);
+	const __m128 vgy = _mm_set1_ps(gy);
+	for(; i<count; i+=4) {
+		__m128 vx = _mm_add_ps(_mm_loadu_ps(&vel_x[i]), vgx);
+		__m128 vy = _mm_add_ps(_mm_loadu_ps(&vel_y[i]), vgy);
+		_mm_storeu_ps(&vel_x[i], vx);
+		_mm_storeu_ps(&vel_y[i], vy);
+		_mm_storeu_ps(&pos_x[i], _mm_add_ps(_mm_loadu_ps(&pos_x[i]), _mm_mul_ps(vx, vdt)));
+		_mm_storeu_ps(&pos_y[i], _mm_add_ps(_mm_loadu_ps(&pos_y[i]), _mm_mul_ps(vy, vdt)));
+		_mm_storeu_ps(&life[i], _mm_sub_ps(_mm_loadu_ps(&life[i]), vdt));
+	}
+#else
+	for(; i<count; i++) {
+		vel_x[i] += gx;
+		vel_y[i] += gy;
+		pos_x[i] += vel_x[i]*dt;
+		pos_y[i] += vel_y[i]*dt;
+		life[i] -= dt;
+	}
+#endif
+}
+
+/**
+ * @brief Remove dead particles moving the last live one into their place
+ */
+void PIXL_ParticleSystem::compact()
+{
+	uint i = 0;
+	while(i < count) {
+		if(life[i] > 0) {
+			i++;
+			continue;
+		}
+
+		count--;
+		pos_x[i] = pos_x[count];
+		pos_y[i] = pos_y[count];
+		vel_x[i] = vel_x[count];
+		vel_y[i] = vel_y[count];
+		life[i] = life[count];
+		inv_life[i] = inv_life[count];
+	}
+}
+
+/**
+ * @brief Draw every particle with one draw call, fading them out as they die
+ */
+void PIXL_ParticleSystem::draw()
+{
+	if(!count)
+		return;
+
+	const float hw = image->w*0.5f;
+	const float hh = image->h*0.5f;
+	const uint batch = PIXL_stream.getCapacity()/4;
+
+	texture->bind();
+
+	// written straight into the vertex stream, in batches if it's huge
+	for(uint first=0; first<count; first+=batch) {
+		uint n = count-first < batch ? count-first : batch;
+		PIXL_Vertex* v = PIXL_stream.map(n*4);
+
+		for(uint i=first; i<first+n; i++, v+=4) {
+			GLubyte alpha = (GLubyte)(life[i]*inv_life[i]*255);
+			float x = pos_x[i];
+			float y = pos_y[i];
+
+			v[0].x = x-hw; v[0].y = y-hh; v[0].s = 0; v[0].t = 0;
+			v[1].x = x-hw; v[1].y = y+hh; v[1].s = 0; v[1].t = 1;
+			v[2].x = x+hw; v[2].y = y+hh; v[2].s = 1; v[2].t = 1;
+			v[3].x = x+hw; v[3].y = y-hh; v[3].s = 1; v[3].t = 0;
+			for(int j=0; j<4; j++) {
+				v[j].color[0] = v[j].color[1] = v[j].color[2] = 255;
+				v[j].color[3] = alpha;
+			}
+		}
+
+		PIXL_stream.draw(GL_QUADS);
+	}
+}
+
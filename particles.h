@@ -0,0 +1,91 @@
+/* 
+ * Copyright (C) 2012 - Brian Gomes Bascoy
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ * 
+ */
+
+#ifndef _PIXL_PARTICLES_H_
+#define _PIXL_PARTICLES_H_
+
+#include <vector>
+#include <GL/glew.h>
+#include <SDL/SDL.h>
+#include <SDL/SDL_image.h>
+
+#include "config.h"
+#include "glstate.h"
+#include "stream.h"
+#include "graphics.h"
+
+/**
+ * @brief Particle emitter settings
+ *
+ * @note Times are in seconds and speeds in pixels per second
+ */
+typedef struct {
+	float x; // where the particles are born
+	float y;
+	float rate; // particles per second
+	float life; // how long each particle lives
+	float angle; // direction in radians
+	float spread; // random variation of the direction
+	float speed_min;
+	float speed_max;
+	bool active;
+	float accumulator; // fraction of particle pending to be spawned
+} PIXL_Emitter;
+
+
+/**
+ * @brief Particles sharing one texture, drawn with a single call
+ *
+ * Particles are stored as structure of arrays so the integration can be done
+ * with SIMD, dead particles are swapped with the last live one so the arrays
+ * stay packed. All the quads are streamed into one VBO every frame.
+ */
+class PIXL_ParticleSystem {
+	public:
+		PIXL_ParticleSystem(const char* f, uint max);
+		virtual ~PIXL_ParticleSystem();
+		uint addEmitter(float x, float y, float rate, float life);
+		PIXL_Emitter* getEmitter(uint i) { return &emitters[i]; } // until the next addEmitter()
+		void setGravity(float x, float y) { gravity_x=x; gravity_y=y; }
+		bool emit(float x, float y, float vx, float vy, float l);
+		void update(float dt);
+		void draw();
+		uint getCount() { return count; }
+		uint getMax() { return max_particles; }
+	private:
+		void integrate(float dt);
+		void compact();
+
+		SDL_Surface* image;
+		PIXL_Texture* texture;
+		std::vector<PIXL_Emitter> emitters;
+		float gravity_x;
+		float gravity_y;
+		uint max_particles;
+		uint count; // live particles, always packed at the beginning
+		// SoA storage, the size is rounded up to a multiple of 4
+		std::vector<float> pos_x;
+		std::vector<float> pos_y;
+		std::vector<float> vel_x;
+		std::vector<float> vel_y;
+		std::vector<float> life; // remaining life
+		std::vector<float> inv_life; // 1/initial life, for fading
+};
+
+#endif // _PIXL_PARTICLES_H_
+
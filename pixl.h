@@ -19,9 +19,26 @@
 #ifndef _PIXL_PIXL_H_
 #define _PIXL_PIXL_H_
 
+#include "animations.h"
 #include "app.h"
+#include "arena.h"
+#include "camera.h"
+#include "collision.h"
+#include "ecs.h"
+#include "effects.h"
 #include "filesystem.h"
+#include "fonts.h"
+#include "glstate.h"
+#include "glyphs.h"
 #include "graphics.h"
+#include "jobs.h"
+#include "map.h"
+#include "particles.h"
+#include "pool.h"
+#include "rendergraph.h"
+#include "renderqueue.h"
+#include "scene.h"
+#include "stream.h"
 
 #endif // _PIXL_PIXL_H_
 
@@ -0,0 +1,168 @@
+/* 
+ * Copyright (C) 2012 - Brian Gomes Bascoy
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ * 
+ */
+
+
+#ifndef _PIXL_POOL_H_
+#define _PIXL_POOL_H_
+
+#include <vector>
+#include <new>
+#include <utility>
+#include <stddef.h>
+#include <stdint.h>
+#include <assert.h>
+
+#include "config.h"
+
+/**
+ * @brief Handle of an object in a PIXL_ObjectPool, the generation tells apart reused slots
+ */
+struct PIXL_Handle {
+	uint32_t index;
+	uint32_t generation;
+	bool operator==(const PIXL_Handle& h) const { return index==h.index && generation==h.generation; }
+	bool operator!=(const PIXL_Handle& h) const { return !(*this==h); }
+};
+
+
+/**
+ * @brief Fixed capacity pool of objects of one type
+ *
+ * All the memory is allocated by the constructor: spawn() and despawn()
+ * only construct and destroy objects in place and take a slot from a free
+ * list, so both are O(1) and never call malloc. Live objects are packed
+ * in one array, despawning moves the last one into the hole, so systems
+ * walk them contiguously:
+ *
+ *   for(uint i=0; i<bullets.getCount(); ) {
+ *       if(bullets[i].update())
+ *           i++;
+ *       else
+ *           bullets.despawn(bullets.getHandle(i)); // i now holds the last one
+ *   }
+ *
+ * Objects move, so keep handles instead of pointers. get() returns NULL
+ * for despawned objects, even if their slot was reused.
+ */
+template<typename T>
+class PIXL_ObjectPool {
+	public:
+		enum { none = 0xFFFFFFFFu };
+
+		PIXL_ObjectPool(uint c): count(0), capacity(c), free_head(none)
+		{
+			objects = static_cast<T*>(::operator new(sizeof(T)*capacity));
+			owners.resize(capacity);
+			slots.resize(capacity);
+			// every slot free, chained in order
+			for(uint i=0; i<capacity; i++) {
+				slots[i].dense = i+1 < capacity ? i+1 : none;
+				slots[i].generation = 0;
+			}
+			free_head = capacity ? 0 : (uint32_t)none;
+		}
+
+		~PIXL_ObjectPool()
+		{
+			for(uint i=0; i<count; i++)
+				objects[i].~T();
+			::operator delete(objects);
+		}
+
+		/**
+		 * @brief Construct an object with the given arguments
+		 *
+		 * @return its handle, getNull() if the pool is full
+		 */
+		template<typename... Args>
+		PIXL_Handle spawn(Args&&... args)
+		{
+			if(free_head == none)
+				return getNull();
+
+			const uint32_t index = free_head;
+			Slot& s = slots[index];
+			free_head = s.dense;
+
+			new(objects + count) T(std::forward<Args>(args)...);
+			owners[count] = index;
+			s.dense = count++;
+
+			PIXL_Handle h = { index, s.generation };
+			return h;
+		}
+
+		void despawn(PIXL_Handle h)
+		{
+			if(!isAlive(h))
+				return;
+
+			Slot& s = slots[h.index];
+			const uint32_t hole = s.dense;
+			const uint32_t last = count-1;
+			if(hole != last) {
+				objects[hole] = std::move(objects[last]);
+				owners[hole] = owners[last];
+				slots[owners[hole]].dense = hole;
+			}
+			objects[last].~T();
+			count--;
+
+			s.generation++;
+			s.dense = free_head;
+			free_head = h.index;
+		}
+
+		bool isAlive(PIXL_Handle h) const
+		{
+			return h.index < capacity && slots[h.index].generation == h.generation
+				&& slots[h.index].dense < count && owners[slots[h.index].dense] == h.index;
+		}
+
+		T* get(PIXL_Handle h) { return isAlive(h) ? objects + slots[h.index].dense : NULL; }
+
+		/**
+		 * @brief Live objects, densely from 0 to getCount()
+		 */
+		T& operator[](uint i) { assert(i < count); return objects[i]; }
+		T* begin() { return objects; }
+		T* end() { return objects + count; }
+		PIXL_Handle getHandle(uint i) const { PIXL_Handle h = { owners[i], slots[owners[i]].generation }; return h; }
+
+		uint getCount() const { return count; }
+		uint getCapacity() const { return capacity; }
+		float getOccupancy() const { return capacity ? count/(float)capacity : 0; }
+		static PIXL_Handle getNull() { PIXL_Handle h = { none, 0 }; return h; }
+	private:
+		typedef struct {
+			uint32_t dense; // position in objects, or next free slot
+			uint32_t generation; // incremented by despawn()
+		} Slot;
+
+		PIXL_ObjectPool(const PIXL_ObjectPool&);
+		PIXL_ObjectPool& operator=(const PIXL_ObjectPool&);
+
+		T* objects; // the first count are alive
+		std::vector<uint32_t> owners; // slot of each object
+		std::vector<Slot> slots;
+		uint count;
+		uint capacity;
+		uint32_t free_head; // first free slot
+};
+
+#endif // _PIXL_POOL_H_
@@ -0,0 +1,364 @@
+/* 
+ * Copyright (C) 2012 - Brian Gomes Bascoy
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ * 
+ */
+
+#include "rendergraph.h"
+
+#include <stdio.h>
+
+PIXL_RenderTargetPool::~PIXL_RenderTargetPool()
+{
+	for(uint i=0; i<targets.size(); i++) {
+		PIXL_gl.deleteFramebuffers(1, &targets[i]->fbo);
+		PIXL_gl.deleteTextures(1, &targets[i]->texture);
+		delete targets[i];
+	}
+}
+
+/**
+ * @brief Get a free render target, creating it only if none is compatible
+ */
+PIXL_RenderTarget* PIXL_RenderTargetPool::acquire(uint w, uint h, GLenum format)
+{
+	for(uint i=0; i<free_targets.size(); i++) {
+		PIXL_RenderTarget* t = free_targets[i];
+		if(t->w == w && t->h == h && t->format == format) {
+			free_targets[i] = free_targets.back();
+			free_targets.pop_back();
+			return t;
+		}
+	}
+
+	PIXL_RenderTarget* t = new PIXL_RenderTarget;
+	t->w = w;
+	t->h = h;
+	t->format = format;
+
+	glGenTextures(1, &t->texture);
+	PIXL_gl.bindTexture(t->texture);
+	// linear so targets at a fraction of the resolution can be upsampled
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexImage2D(GL_TEXTURE_2D, 0, format, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+
+	glGenFramebuffers(1, &t->fbo);
+	PIXL_gl.bindFramebuffer(t->fbo);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, t->texture, 0);
+	if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		puts("FBO error");
+	PIXL_gl.bindFramebuffer(0);
+
+	targets.push_back(t);
+
+	return t;
+}
+
+void PIXL_RenderTargetPool::release(PIXL_RenderTarget* target)
+{
+	free_targets.push_back(target);
+}
+
+/**
+ * @brief Free the GL objects of the targets nobody is using
+ */
+void PIXL_RenderTargetPool::trim()
+{
+	for(uint i=0; i<free_targets.size(); i++) {
+		PIXL_RenderTarget* t = free_targets[i];
+		PIXL_gl.deleteFramebuffers(1, &t->fbo);
+		PIXL_gl.deleteTextures(1, &t->texture);
+		for(uint j=0; j<targets.size(); j++) {
+			if(targets[j] == t) {
+				targets[j] = targets.back();
+				targets.pop_back();
+				break;
+			}
+		}
+		delete t;
+	}
+	free_targets.clear();
+}
+
+
+/**
+ * @brief Render graph constructor
+ *
+ * @param p pool to take the targets from, NULL to use a private one
+ */
+PIXL_RenderGraph::PIXL_RenderGraph(PIXL_RenderTargetPool* p): pool(p), own_pool(p == NULL), compiled(false), last_w(0), last_h(0)
+{
+	if(own_pool)
+		pool = new PIXL_RenderTargetPool();
+}
+
+PIXL_RenderGraph::~PIXL_RenderGraph()
+{
+	if(own_pool)
+		delete pool;
+}
+
+uint PIXL_RenderGraph::resource(const char* name)
+{
+	std::map<std::string, uint>::iterator it = names.find(name);
+	if(it != names.end())
+		return it->second;
+
+	Resource r;
+	r.name = name;
+	r.external = false;
+	r.screen = r.name == "screen";
+	r.texture = 0;
+	r.w = r.h = 0;
+	r.format = GL_RGBA8;
+	r.last_read = -1;
+	r.target = NULL;
+	resources.push_back(r);
+	compiled = false;
+
+	return names[name] = resources.size()-1;
+}
+
+/**
+ * @brief Add a full screen pass
+ *
+ * @param shader fragment shader (see PIXL_loadShader), 0 to just copy
+ * @param input texture bound to unit 0
+ * @param output where to draw, "screen" for the window
+ * @param scale resolution of the output relative to the window
+ *
+ * @return pass index
+ */
+uint PIXL_RenderGraph::addPass(GLuint shader, const char* input, const char* output, float scale)
+{
+	Pass p;
+	p.shader = shader;
+	p.inputs.push_back(resource(input));
+	p.output = resource(output);
+	p.scale = scale;
+	p.w = p.h = -1;
+	passes.push_back(p);
+	compiled = false;
+
+	return passes.size()-1;
+}
+
+/**
+ * @brief Bind another texture to a pass, on the next texture unit
+ */
+void PIXL_RenderGraph::addInput(uint pass, const char* input)
+{
+	passes[pass].inputs.push_back(resource(input));
+	compiled = false;
+}
+
+/**
+ * @brief Set a float uniform of the shader of a pass every time it runs
+ */
+void PIXL_RenderGraph::setUniform(uint pass, const char* name, float value)
+{
+	Pass& p = passes[pass];
+	GLint location = p.shader ? glGetUniformLocation(p.shader, name) : -1;
+	if(location < 0)
+		return;
+
+	for(uint i=0; i<p.uniforms.size(); i++) {
+		if(p.uniforms[i].location == location) {
+			p.uniforms[i].value = value;
+			return;
+		}
+	}
+
+	Uniform u;
+	u.location = location;
+	u.value = value;
+	p.uniforms.push_back(u);
+}
+
+/**
+ * @brief Use a texture that is not managed by the graph (eg a PIXL_FBO one)
+ *
+ * @param w width, 0 for the window width
+ * @param h height, 0 for the window height
+ */
+void PIXL_RenderGraph::setTexture(const char* name, GLuint texture, uint w, uint h)
+{
+	Resource& r = resources[resource(name)];
+	r.external = true;
+	r.texture = texture;
+	r.w = w;
+	r.h = h;
+}
+
+/**
+ * @brief Internal format of an intermediate target (GL_RGBA8 by default)
+ */
+void PIXL_RenderGraph::setFormat(const char* name, GLenum format)
+{
+	resources[resource(name)].format = format;
+}
+
+/**
+ * @brief Remove every pass and resource, the pooled targets are kept
+ */
+void PIXL_RenderGraph::clear()
+{
+	passes.clear();
+	resources.clear();
+	names.clear();
+	compiled = false;
+}
+
+/**
+ * @brief Find out when each target can go back to the pool
+ */
+void PIXL_RenderGraph::compile()
+{
+	std::vector<bool> written(resources.size(), false);
+
+	for(uint r=0; r<resources.size(); r++)
+		resources[r].last_read = -1;
+
+	for(uint i=0; i<passes.size(); i++) {
+		Pass& p = passes[i];
+
+		for(uint j=0; j<p.inputs.size(); j++) {
+			Resource& in = resources[p.inputs[j]];
+			if(!in.external && !written[p.inputs[j]])
+				fprintf(stderr, "Render graph: \"%s\" is read before being written\n", in.name.c_str());
+			in.last_read = i;
+		}
+		written[p.output] = true;
+
+		p.samplers.clear();
+		for(uint j=0; j<p.inputs.size(); j++) {
+			char sampler[16];
+			snprintf(sampler, sizeof(sampler), "sampler%u", j);
+			p.samplers.push_back(p.shader ? glGetUniformLocation(p.shader, sampler) : -1);
+		}
+		p.w = p.shader ? glGetUniformLocation(p.shader, "w") : -1;
+		p.h = p.shader ? glGetUniformLocation(p.shader, "h") : -1;
+	}
+
+	compiled = true;
+}
+
+/**
+ * @brief Run every pass in order
+ */
+void PIXL_RenderGraph::execute()
+{
+	if(!compiled)
+		compile();
+
+	// intermediate targets follow the render resolution, not the window
+	const uint screen_w = PIXL_config.getRenderWidth();
+	const uint screen_h = PIXL_config.getRenderHeight();
+	if(screen_w != last_w || screen_h != last_h) {
+		// the scale changed, targets of the old size would never be used again
+		pool->trim();
+		last_w = screen_w;
+		last_h = screen_h;
+	}
+	bool blend = PIXL_gl.isEnabled(GL_BLEND);
+	// the passes drawing to the window upscale like PIXL_FBO::draw()
+	const bool nearest = PIXL_config.getUpscaling() == PIXL_config.integer;
+
+	// passes overwrite their output
+	PIXL_gl.disable(GL_BLEND);
+
+	for(uint i=0; i<passes.size(); i++) {
+		Pass& p = passes[i];
+		Resource& out = resources[p.output];
+
+		if(out.screen) {
+			PIXL_bindScreen();
+		} else {
+			if(!out.target) {
+				uint w = (uint)(screen_w*p.scale);
+				uint h = (uint)(screen_h*p.scale);
+				out.target = pool->acquire(w ? w : 1, h ? h : 1, out.format);
+			}
+			PIXL_gl.bindFramebuffer(out.target->fbo);
+			PIXL_gl.viewport(0, 0, out.target->w, out.target->h);
+		}
+
+		PIXL_gl.useProgram(p.shader);
+		for(uint j=0; j<p.uniforms.size(); j++)
+			glUniform1f(p.uniforms[j].location, p.uniforms[j].value);
+
+		// min and mag filter of every input, external textures get theirs back
+		std::vector<GLint> filters(out.screen && nearest ? 2*p.inputs.size() : 0);
+		for(int j=p.inputs.size()-1; j>=0; j--) {
+			Resource& in = resources[p.inputs[j]];
+			PIXL_gl.activeTexture(GL_TEXTURE0 + j);
+			PIXL_gl.bindTexture(in.target ? in.target->texture : in.texture);
+			if(out.screen && nearest) {
+				glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, &filters[2*j]);
+				glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, &filters[2*j+1]);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+			}
+			if(p.samplers[j] >= 0)
+				glUniform1i(p.samplers[j], j);
+
+			if(j == 0) {
+				// texel size of the input, for blurs and the like
+				uint w = in.target ? in.target->w : (in.w ? in.w : screen_w);
+				uint h = in.target ? in.target->h : (in.h ? in.h : screen_h);
+				if(p.w >= 0)
+					glUniform1f(p.w, w);
+				if(p.h >= 0)
+					glUniform1f(p.h, h);
+			}
+		}
+
+		PIXL_gl.enable(GL_TEXTURE_2D);
+		PIXL_stream.quad(0, 0, *PIXL_config.w, *PIXL_config.h, 0, 1, 1, 0);
+
+		if(out.screen && nearest) {
+			// back to the filters they had, ending on unit 0
+			for(int j=p.inputs.size()-1; j>=0; j--) {
+				Resource& in = resources[p.inputs[j]];
+				PIXL_gl.activeTexture(GL_TEXTURE0 + j);
+				PIXL_gl.bindTexture(in.target ? in.target->texture : in.texture);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filters[2*j]);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filters[2*j+1]);
+			}
+		}
+
+		// targets nobody reads anymore can be reused by the next passes
+		for(uint j=0; j<p.inputs.size(); j++) {
+			Resource& in = resources[p.inputs[j]];
+			if(in.target && in.last_read == (int)i) {
+				pool->release(in.target);
+				in.target = NULL;
+			}
+		}
+		if(out.target && out.last_read <= (int)i) {
+			pool->release(out.target);
+			out.target = NULL;
+		}
+	}
+
+	PIXL_gl.useProgram(0);
+	PIXL_bindScreen();
+	if(blend)
+		PIXL_gl.enable(GL_BLEND);
+}
+
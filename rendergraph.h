@@ -0,0 +1,138 @@
+/* 
+ * Copyright (C) 2012 - Brian Gomes Bascoy
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ * 
+ */
+
+#ifndef _PIXL_RENDERGRAPH_H_
+#define _PIXL_RENDERGRAPH_H_
+
+#include <map>
+#include <vector>
+#include <string>
+#include <GL/glew.h>
+
+#include "config.h"
+#include "glstate.h"
+#include "stream.h"
+
+/**
+ * @brief Texture plus framebuffer owned by a PIXL_RenderTargetPool
+ */
+typedef struct {
+	GLuint fbo;
+	GLuint texture;
+	uint w;
+	uint h;
+	GLenum format;
+} PIXL_RenderTarget;
+
+
+/**
+ * @brief Recycles render targets of the same size and format
+ */
+class PIXL_RenderTargetPool {
+	public:
+		PIXL_RenderTargetPool() {}
+		~PIXL_RenderTargetPool();
+		PIXL_RenderTarget* acquire(uint w, uint h, GLenum format=GL_RGBA8);
+		void release(PIXL_RenderTarget* target);
+		void trim();
+		uint getCount() { return targets.size(); }
+	private:
+		PIXL_RenderTargetPool(const PIXL_RenderTargetPool&);
+		PIXL_RenderTargetPool& operator=(const PIXL_RenderTargetPool&);
+		std::vector<PIXL_RenderTarget*> targets; // every target allocated
+		std::vector<PIXL_RenderTarget*> free_targets;
+};
+
+
+/**
+ * @brief Declarative post-processing chain
+ *
+ * Passes read named textures and write a named texture at a fraction of
+ * the screen resolution. The special output "screen" is the window, other
+ * names are either external textures (see setTexture()) or intermediate
+ * targets taken from the pool when first written and given back after
+ * their last read, so passes later in the frame reuse them:
+ *
+ *   graph.setTexture("scene", myfbo->getTexture());
+ *   graph.addPass(PIXL_loadShader("gbh.glsl"), "scene", "blur");
+ *   graph.addPass(PIXL_loadShader("gbv.glsl"), "blur", "screen");
+ *   ...
+ *   graph.execute();
+ *
+ * Input n is bound to texture unit n and the "sampler<n>" uniform, "w" and
+ * "h" are set to the size of the first input.
+ */
+class PIXL_RenderGraph {
+	public:
+		PIXL_RenderGraph(PIXL_RenderTargetPool* p=NULL);
+		~PIXL_RenderGraph();
+		uint addPass(GLuint shader, const char* input, const char* output, float scale=1.f);
+		void addInput(uint pass, const char* input);
+		void setUniform(uint pass, const char* name, float value);
+		void setTexture(const char* name, GLuint texture, uint w=0, uint h=0);
+		void setFormat(const char* name, GLenum format);
+		void clear();
+		void execute();
+		PIXL_RenderTargetPool* getPool() { return pool; }
+	private:
+		typedef struct {
+			std::string name;
+			bool external; // texture given with setTexture()
+			bool screen;
+			GLuint texture; // external only
+			uint w;
+			uint h;
+			GLenum format;
+			int last_read; // pass index, computed by compile()
+			PIXL_RenderTarget* target; // while alive during execute()
+		} Resource;
+
+		typedef struct {
+			GLint location;
+			float value;
+		} Uniform;
+
+		typedef struct {
+			GLuint shader;
+			std::vector<uint> inputs;
+			uint output;
+			float scale;
+			std::vector<GLint> samplers; // uniform locations, computed by compile()
+			GLint w;
+			GLint h;
+			std::vector<Uniform> uniforms;
+		} Pass;
+
+		PIXL_RenderGraph(const PIXL_RenderGraph&);
+		PIXL_RenderGraph& operator=(const PIXL_RenderGraph&);
+
+		uint resource(const char* name);
+		void compile();
+
+		PIXL_RenderTargetPool* pool;
+		bool own_pool;
+		bool compiled;
+		uint last_w; // render resolution of the last execute()
+		uint last_h;
+		std::vector<Resource> resources;
+		std::map<std::string, uint> names;
+		std::vector<Pass> passes;
+};
+
+#endif // _PIXL_RENDERGRAPH_H_
+
@@ -0,0 +1,317 @@
+/* 
+ * Copyright (C) 2012 - Brian Gomes Bascoy
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ * 
+ */
+
+#include "renderqueue.h"
+#include "camera.h"
+#include "graphics.h"
+
+#include <stdio.h>
+#include <string.h>
+
+PIXL_RenderQueue::PIXL_RenderQueue(): target(screen), layer(0), depth(0), shader(0), blend(alpha), camera(NULL), draw_calls(0), state_changes(0)
+{
+	memset(color, 255, 4);
+}
+
+/**
+ * @brief Where the next commands draw, NULL for the screen
+ *
+ * @param fbo the target
+ * @param clear clear it before its first command of every flush
+ */
+void PIXL_RenderQueue::setTarget(PIXL_FBO* fbo, bool clear)
+{
+	if(!fbo) {
+		target = screen;
+		return;
+	}
+
+	for(uint i=0; i<targets.size(); i++) {
+		if(targets[i] == fbo) {
+			target = i;
+			clears[i] = clear;
+			return;
+		}
+	}
+
+	if(targets.size() == screen) {
+		puts("Render queue: too many targets");
+		return;
+	}
+	target = targets.size();
+	targets.push_back(fbo);
+	clears.push_back(clear);
+}
+
+void PIXL_RenderQueue::setColor(GLubyte r, GLubyte g, GLubyte b, GLubyte a)
+{
+	color[0] = r;
+	color[1] = g;
+	color[2] = b;
+	color[3] = a;
+}
+
+/**
+ * @brief Queue a textured quad with the current state
+ */
+void PIXL_RenderQueue::quad(GLuint texture, float x0, float y0, float x1, float y1, float s0, float t0, float s1, float t1)
+{
+	Command c;
+	c.texture = texture;
+	c.x[0] = x0; c.y[0] = y0;
+	c.x[1] = x0; c.y[1] = y1;
+	c.x[2] = x1; c.y[2] = y1;
+	c.x[3] = x1; c.y[3] = y0;
+	c.s0 = s0; c.t0 = t0; c.s1 = s1; c.t1 = t1;
+	push(c);
+}
+
+/**
+ * @brief Queue a w*h quad transformed by m, see PIXL_SceneGraph
+ */
+void PIXL_RenderQueue::quad(GLuint texture, const PIXL_Affine& m, float w, float h, float s0, float t0, float s1, float t1)
+{
+	Command c;
+	c.texture = texture;
+	c.x[0] = m.x; c.y[0] = m.y;
+	c.x[1] = m.getX(0, h); c.y[1] = m.getY(0, h);
+	c.x[2] = m.getX(w, h); c.y[2] = m.getY(w, h);
+	c.x[3] = m.getX(w, 0); c.y[3] = m.getY(w, 0);
+	c.s0 = s0; c.t0 = t0; c.s1 = s1; c.t1 = t1;
+	push(c);
+}
+
+/**
+ * @brief Cull a quad with its corners set and queue it with the current state
+ */
+void PIXL_RenderQueue::push(Command& c)
+{
+	if(camera) {
+		float x0 = c.x[0], y0 = c.y[0], x1 = c.x[0], y1 = c.y[0];
+		for(int i=1; i<4; i++) {
+			x0 = c.x[i] < x0 ? c.x[i] : x0;
+			y0 = c.y[i] < y0 ? c.y[i] : y0;
+			x1 = c.x[i] > x1 ? c.x[i] : x1;
+			y1 = c.y[i] > y1 ? c.y[i] : y1;
+		}
+		if(camera->cull(x0, y0, x1, y1))
+			return;
+	}
+
+	c.target = target;
+	c.shader = shader;
+	c.blend = blend;
+	memcpy(c.color, color, 4);
+	c.camera = camera;
+	c.fn = NULL;
+	c.data = NULL;
+
+	commands.push_back(c);
+	keys.push_back(key(c));
+}
+
+/**
+ * @brief Queue a function drawing by itself, on the current target
+ */
+void PIXL_RenderQueue::call(void (*fn)(void*), void* data)
+{
+	Command c;
+	memset(&c, 0, sizeof(c));
+	c.target = target;
+	c.camera = camera;
+	c.fn = fn;
+	c.data = data;
+
+	commands.push_back(c);
+	keys.push_back(key(c));
+}
+
+uint64_t PIXL_RenderQueue::key(const Command& c)
+{
+	// callbacks go after the quads of their depth, always in order
+	const uint64_t s = c.fn ? 0xFFF : c.shader & 0xFFF;
+	const uint64_t t = c.fn ? 0xFFFF : c.texture & 0xFFFF;
+	const uint64_t b = c.blend & 0x3;
+	const bool translucent = c.fn || c.blend != none;
+
+	uint64_t k = (uint64_t)c.target << 60 | (uint64_t)layer << 52;
+	if(translucent)
+		k |= 1ULL << 51 | (uint64_t)depth << 35 | s << 23 | t << 7 | b << 5;
+	else
+		k |= s << 39 | t << 23 | b << 21;
+	return k;
+}
+
+/**
+ * @brief LSD radix sort of the keys, 8 bits per pass
+ *
+ * Passes where every key has the same byte are skipped, usually most of
+ * them since the keys share the target and layer bits.
+ */
+void PIXL_RenderQueue::sort()
+{
+	const uint n = keys.size();
+	order.resize(n);
+	order_tmp.resize(n);
+	keys_tmp.resize(n);
+	for(uint i=0; i<n; i++)
+		order[i] = i;
+
+	for(uint shift=0; shift<64; shift+=8) {
+		uint count[256];
+		memset(count, 0, sizeof(count));
+		for(uint i=0; i<n; i++)
+			count[(keys[i] >> shift) & 0xFF]++;
+
+		if(count[(keys[0] >> shift) & 0xFF] == n)
+			continue;
+
+		uint sum = 0;
+		for(uint i=0; i<256; i++) {
+			uint c = count[i];
+			count[i] = sum;
+			sum += c;
+		}
+
+		for(uint i=0; i<n; i++) {
+			uint dst = count[(keys[i] >> shift) & 0xFF]++;
+			keys_tmp[dst] = keys[i];
+			order_tmp[dst] = order[i];
+		}
+		keys.swap(keys_tmp);
+		order.swap(order_tmp);
+	}
+}
+
+/**
+ * @brief Set the state of a command, touching only what changed
+ */
+void PIXL_RenderQueue::bind(const Command& c, const Command* last)
+{
+	if(!last || c.target != last->target) {
+		if(c.target == screen)
+			PIXL_bindScreen();
+		else
+			targets[c.target]->bind();
+		if(c.target != screen && clears[c.target] && !cleared[c.target]) {
+			glClear(GL_COLOR_BUFFER_BIT);
+			cleared[c.target] = true;
+		}
+		state_changes++;
+	}
+
+	if(c.camera != PIXL_Camera::getCurrent()) {
+		if(c.camera)
+			c.camera->apply();
+		else
+			PIXL_Camera::reset();
+		state_changes++;
+	}
+
+	if(c.fn)
+		return;
+
+	if(!last || last->fn || c.shader != last->shader) {
+		PIXL_gl.useProgram(c.shader);
+		state_changes++;
+	}
+	if(!last || last->fn || c.texture != last->texture) {
+		PIXL_gl.enable(GL_TEXTURE_2D);
+		PIXL_gl.bindTexture(c.texture);
+		state_changes++;
+	}
+	if(!last || last->fn || c.blend != last->blend) {
+		if(c.blend == none) {
+			PIXL_gl.disable(GL_BLEND);
+		} else {
+			PIXL_gl.enable(GL_BLEND);
+			PIXL_gl.blendFunc(c.blend == premultiplied ? GL_ONE : GL_SRC_ALPHA, c.blend == additive ? GL_ONE : GL_ONE_MINUS_SRC_ALPHA);
+		}
+		state_changes++;
+	}
+}
+
+/**
+ * @brief Sort and draw everything queued since the last flush
+ */
+void PIXL_RenderQueue::flush()
+{
+	draw_calls = 0;
+	state_changes = 0;
+	if(commands.empty())
+		return;
+
+	sort();
+	cleared.assign(targets.size(), false);
+
+	const Command* last = NULL;
+	uint i = 0;
+	while(i < order.size()) {
+		const Command& c = commands[order[i]];
+		bind(c, last);
+		last = &c;
+
+		if(c.fn) {
+			c.fn(c.data);
+			draw_calls++;
+			i++;
+			// the callback may have changed anything
+			last = NULL;
+			continue;
+		}
+
+		// batch the following quads with the same state
+		uint n = 1;
+		while(i+n < order.size() && n < PIXL_stream.getCapacity()/4) {
+			const Command& o = commands[order[i+n]];
+			if(o.fn || o.target != c.target || o.camera != c.camera || o.shader != c.shader || o.texture != c.texture || o.blend != c.blend)
+				break;
+			n++;
+		}
+
+		PIXL_Vertex* v = PIXL_stream.map(n*4);
+		for(uint j=0; j<n; j++, v+=4) {
+			const Command& q = commands[order[i+j]];
+			v[0].s = q.s0; v[0].t = q.t0;
+			v[1].s = q.s0; v[1].t = q.t1;
+			v[2].s = q.s1; v[2].t = q.t1;
+			v[3].s = q.s1; v[3].t = q.t0;
+			for(int k=0; k<4; k++) {
+				v[k].x = q.x[k];
+				v[k].y = q.y[k];
+				memcpy(v[k].color, q.color, 4);
+			}
+		}
+		PIXL_stream.draw(GL_QUADS);
+		draw_calls++;
+		i += n;
+	}
+
+	// back to the defaults of PIXL_App
+	PIXL_gl.useProgram(0);
+	PIXL_gl.enable(GL_BLEND);
+	PIXL_gl.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	if(last == NULL || last->target != screen)
+		PIXL_bindScreen();
+	if(PIXL_Camera::getCurrent())
+		PIXL_Camera::reset();
+
+	commands.clear();
+	keys.clear();
+}
+
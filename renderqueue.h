@@ -0,0 +1,118 @@
+/* 
+ * Copyright (C) 2012 - Brian Gomes Bascoy
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ * 
+ */
+
+#ifndef _PIXL_RENDERQUEUE_H_
+#define _PIXL_RENDERQUEUE_H_
+
+#include <stdint.h>
+#include <vector>
+#include <GL/glew.h>
+
+#include "config.h"
+#include "glstate.h"
+#include "scene.h"
+#include "stream.h"
+
+class PIXL_FBO;
+class PIXL_Camera;
+
+/**
+ * @brief Sorted queue of draw commands
+ *
+ * Quads and callbacks are submitted in any order with the current state
+ * (target, layer, shader, blending...) and flush() draws them sorted by a
+ * 64 bit key, most significant bits first:
+ *
+ *   target (4) | layer (8) | translucent (1) | ...
+ *     opaque:      shader (12) | texture (16) | blend (2)
+ *     translucent: depth (16) | shader (12) | texture (16) | blend (2)
+ *
+ * FBOs are drawn in the order they were first used and the screen last,
+ * layers in increasing order. Opaque quads are grouped by state, blended
+ * ones are drawn back to front by depth and grouped only within the same
+ * depth. The sort is stable, so equal keys keep their submission order.
+ * Consecutive quads with the same state are drawn with one call.
+ *
+ * Callbacks (for anything that is not a quad, like a render graph) are
+ * drawn after the quads of their depth, in submission order.
+ *
+ * With setCamera() the following quads are in world coordinates: the ones
+ * out of the view are dropped right away and the camera is applied when
+ * they are drawn. The camera is not part of the key, keep one camera per
+ * target and layer to avoid switching back and forth.
+ */
+class PIXL_RenderQueue {
+	public:
+		enum { none, alpha, additive, premultiplied }; // blending
+		PIXL_RenderQueue();
+		void setTarget(PIXL_FBO* fbo, bool clear=false);
+		void setLayer(uint l) { layer = l > 255 ? 255 : l; }
+		void setDepth(uint d) { depth = d > 0xFFFF ? 0xFFFF : d; }
+		void setShader(GLuint s) { shader = s; }
+		void setBlend(int b) { blend = b; }
+		int getBlend() { return blend; }
+		void setColor(GLubyte r, GLubyte g, GLubyte b, GLubyte a);
+		void setCamera(PIXL_Camera* c) { camera = c; }
+		void quad(GLuint texture, float x0, float y0, float x1, float y1, float s0=0, float t0=0, float s1=1, float t1=1);
+		void quad(GLuint texture, const PIXL_Affine& m, float w, float h, float s0=0, float t0=0, float s1=1, float t1=1);
+		void call(void (*fn)(void*), void* data);
+		void flush();
+		uint getCount() { return commands.size(); }
+		uint getDrawCalls() { return draw_calls; }
+		uint getStateChanges() { return state_changes; }
+	private:
+		typedef struct {
+			uint target;
+			GLuint texture;
+			GLuint shader;
+			int blend;
+			float x[4], y[4]; // corners, top left first, counterclockwise
+			float s0, t0, s1, t1;
+			GLubyte color[4];
+			PIXL_Camera* camera;
+			void (*fn)(void*); // NULL for quads
+			void* data;
+		} Command;
+
+		enum { screen = 15 };
+		void push(Command& c);
+		uint64_t key(const Command& c);
+		void sort();
+		void bind(const Command& c, const Command* last);
+
+		std::vector<Command> commands;
+		std::vector<uint64_t> keys;
+		std::vector<uint64_t> keys_tmp;
+		std::vector<uint> order;
+		std::vector<uint> order_tmp;
+		std::vector<PIXL_FBO*> targets; // index in the key, the screen is 15
+		std::vector<bool> clears;
+		std::vector<bool> cleared; // during flush()
+		uint target;
+		uint layer;
+		uint depth;
+		GLuint shader;
+		int blend;
+		GLubyte color[4];
+		PIXL_Camera* camera;
+		uint draw_calls; // of the last flush()
+		uint state_changes;
+};
+
+#endif // _PIXL_RENDERQUEUE_H_
+
@@ -0,0 +1,167 @@
+/* 
+ * Copyright (C) 2012 - Brian Gomes Bascoy
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ * 
+ */
+
+
+#include "scene.h"
+
+#include <math.h>
+
+/**
+ * @brief Add a node at the origin of its parent
+ *
+ * @param p parent node, none for a root
+ * @return the node
+ */
+uint PIXL_SceneGraph::add(uint p)
+{
+	uint h;
+	if(!free_handles.empty()) {
+		h = free_handles.back();
+		free_handles.pop_back();
+	} else {
+		h = slot.size();
+		slot.push_back(0);
+	}
+
+	// the end of the array is after any parent
+	slot[h] = parent.size();
+	parent.push_back(p == none ? none : slot[p]);
+	pos_x.push_back(0);
+	pos_y.push_back(0);
+	rotation.push_back(0);
+	scale_x.push_back(1);
+	scale_y.push_back(1);
+	PIXL_Affine identity = { 1, 0, 0, 1, 0, 0 };
+	world.push_back(identity);
+	dirty.push_back(1);
+	handle.push_back(h);
+
+	return h;
+}
+
+/**
+ * @brief Remove a node and all its descendants
+ *
+ * The array is compacted keeping the order, so it stays parent first.
+ */
+void PIXL_SceneGraph::remove(uint node)
+{
+	const uint first = slot[node];
+	const uint n = parent.size();
+
+	// descendants come after the node, a node is removed if its parent is
+	std::vector<uint> moved(n - first);
+	uint j = first;
+	for(uint i=first; i<n; i++) {
+		const uint p = parent[i];
+		if(i == first || (p != none && p >= first && moved[p-first] == none)) {
+			moved[i-first] = none;
+			free_handles.push_back(handle[i]);
+			continue;
+		}
+
+		moved[i-first] = j;
+		parent[j] = p != none && p >= first ? moved[p-first] : p;
+		pos_x[j] = pos_x[i];
+		pos_y[j] = pos_y[i];
+		rotation[j] = rotation[i];
+		scale_x[j] = scale_x[i];
+		scale_y[j] = scale_y[i];
+		world[j] = world[i];
+		dirty[j] = dirty[i];
+		handle[j] = handle[i];
+		slot[handle[j]] = j;
+		j++;
+	}
+
+	parent.resize(j);
+	pos_x.resize(j);
+	pos_y.resize(j);
+	rotation.resize(j);
+	scale_x.resize(j);
+	scale_y.resize(j);
+	world.resize(j);
+	dirty.resize(j);
+	handle.resize(j);
+}
+
+void PIXL_SceneGraph::setPos(uint node, float x, float y)
+{
+	const uint i = slot[node];
+	pos_x[i] = x;
+	pos_y[i] = y;
+	dirty[i] = 1;
+}
+
+void PIXL_SceneGraph::setRotation(uint node, float degrees)
+{
+	const uint i = slot[node];
+	rotation[i] = degrees;
+	dirty[i] = 1;
+}
+
+void PIXL_SceneGraph::setScale(uint node, float sx, float sy)
+{
+	const uint i = slot[node];
+	scale_x[i] = sx;
+	scale_y[i] = sy;
+	dirty[i] = 1;
+}
+
+/**
+ * @brief Recompute the world transforms of the changed subtrees
+ *
+ * Parents are before their children, so one pass sees the parent already
+ * updated and marked dirty when it changed.
+ */
+void PIXL_SceneGraph::update()
+{
+	const uint n = parent.size();
+	updated = 0;
+
+	for(uint i=0; i<n; i++) {
+		const uint p = parent[i];
+		if(!dirty[i] && (p == none || !dirty[p]))
+			continue;
+		dirty[i] = 1; // for the children
+
+		const float r = rotation[i] * M_PI / 180.f;
+		const float cs = cosf(r);
+		const float sn = sinf(r);
+		const PIXL_Affine local = { cs*scale_x[i], sn*scale_x[i], -sn*scale_y[i], cs*scale_y[i], pos_x[i], pos_y[i] };
+
+		if(p == none) {
+			world[i] = local;
+		} else {
+			const PIXL_Affine& m = world[p];
+			PIXL_Affine w = {
+				m.a*local.a + m.c*local.b,
+				m.b*local.a + m.d*local.b,
+				m.a*local.c + m.c*local.d,
+				m.b*local.c + m.d*local.d,
+				m.getX(local.x, local.y),
+				m.getY(local.x, local.y)
+			};
+			world[i] = w;
+		}
+		updated++;
+	}
+
+	if(updated)
+		dirty.assign(n, 0);
+}
@@ -0,0 +1,91 @@
+/* 
+ * Copyright (C) 2012 - Brian Gomes Bascoy
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ * 
+ */
+
+
+#ifndef _PIXL_SCENE_H_
+#define _PIXL_SCENE_H_
+
+#include <vector>
+
+#include "config.h"
+
+/**
+ * @brief 2D affine transform, (x', y') = (a*x + c*y + x, b*x + d*y + y)
+ */
+typedef struct PIXL_Affine {
+	float a, b, c, d;
+	float x, y;
+
+	float getX(float px, float py) const { return a*px + c*py + x; }
+	float getY(float px, float py) const { return b*px + d*py + y; }
+	void getBounds(float w, float h, float* x0, float* y0, float* x1, float* y1) const {
+		// the box spans from the origin the sum of the negative (positive) parts of the axes
+		*x0 = x + (a*w < 0 ? a*w : 0) + (c*h < 0 ? c*h : 0);
+		*x1 = x + (a*w > 0 ? a*w : 0) + (c*h > 0 ? c*h : 0);
+		*y0 = y + (b*w < 0 ? b*w : 0) + (d*h < 0 ? d*h : 0);
+		*y1 = y + (b*w > 0 ? b*w : 0) + (d*h > 0 ? d*h : 0);
+	}
+} PIXL_Affine;
+
+/**
+ * @brief Hierarchy of transforms, for objects made of several parts
+ *
+ * Nodes have a local position, rotation and scale relative to their
+ * parent and are kept in a flat array where parents always come before
+ * their children. Changing a node only marks it dirty, update() then
+ * walks the array once and recomputes the world transforms of the dirty
+ * nodes and everything below them, the rest keep their cached matrices.
+ *
+ * getWorld() feeds the transformed sprite and text draws, see
+ * PIXL_Sprite::draw() and PIXL_TextRenderer::print(). Nodes are handles
+ * that stay valid until remove(), which also removes the children.
+ */
+class PIXL_SceneGraph {
+	public:
+		enum { none = 0xFFFFFFFF }; // parent of the root nodes
+		PIXL_SceneGraph(): updated(0) {}
+		uint add(uint parent=none);
+		void remove(uint node);
+		void setPos(uint node, float x, float y);
+		void setRotation(uint node, float degrees);
+		void setScale(uint node, float sx, float sy);
+		float getX(uint node) { return pos_x[slot[node]]; }
+		float getY(uint node) { return pos_y[slot[node]]; }
+		float getRotation(uint node) { return rotation[slot[node]]; }
+		void update();
+		const PIXL_Affine& getWorld(uint node) { return world[slot[node]]; }
+		uint getCount() { return parent.size(); }
+		uint getUpdated() { return updated; }
+	private:
+		// one entry per node, in hierarchy order
+		std::vector<uint> parent; // index in these arrays, always lower, or none
+		std::vector<float> pos_x;
+		std::vector<float> pos_y;
+		std::vector<float> rotation;
+		std::vector<float> scale_x;
+		std::vector<float> scale_y;
+		std::vector<PIXL_Affine> world;
+		std::vector<unsigned char> dirty;
+		std::vector<uint> handle; // of the node
+
+		std::vector<uint> slot; // index of every handle
+		std::vector<uint> free_handles;
+		uint updated; // world transforms computed by the last update()
+};
+
+#endif // _PIXL_SCENE_H_
@@ -0,0 +1,242 @@
+/* 
+ * Copyright (C) 2012 - Brian Gomes Bascoy
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ * 
+ */
+
+#include "stream.h"
+
+#include <stdio.h>
+#include <string.h>
+
+/*
+ * Shared by every draw, like PIXL_gl
+ *
+ */
+PIXL_VertexStream PIXL_stream;
+
+
+PIXL_VertexStream::PIXL_VertexStream(size_t bytes):
+	vbo(0), capacity(bytes - bytes % sizeof(PIXL_Vertex)), persistent(false), memory(NULL),
+	head(0), in_flight(0), frame_bytes(0), written(0), last_written(0), mapped_offset(0), mapped_count(0)
+{
+}
+
+void PIXL_VertexStream::create()
+{
+	glGenBuffers(1, &vbo);
+	PIXL_gl.bindBuffer(GL_ARRAY_BUFFER, vbo);
+
+	persistent = GLEW_ARB_buffer_storage;
+	if(persistent) {
+		const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(GL_ARRAY_BUFFER, capacity, NULL, flags);
+		memory = (PIXL_Vertex*)glMapBufferRange(GL_ARRAY_BUFFER, 0, capacity, flags);
+		if(!memory) {
+			puts("Persistent mapping failed, streaming with glBufferSubData");
+			PIXL_gl.deleteBuffers(1, &vbo);
+			glGenBuffers(1, &vbo);
+			PIXL_gl.bindBuffer(GL_ARRAY_BUFFER, vbo);
+			persistent = false;
+		}
+	}
+
+	if(!persistent) {
+		glBufferData(GL_ARRAY_BUFFER, capacity, NULL, GL_STREAM_DRAW);
+		staging.resize(capacity/sizeof(PIXL_Vertex));
+		memory = &staging[0];
+	}
+}
+
+/**
+ * @brief Free the buffer, while the GL context is still alive
+ */
+void PIXL_VertexStream::release()
+{
+	if(!vbo)
+		return;
+
+	for(uint i=0; i<frames.size(); i++)
+		glDeleteSync(frames[i].fence);
+	frames.clear();
+
+	if(persistent) {
+		PIXL_gl.bindBuffer(GL_ARRAY_BUFFER, vbo);
+		glUnmapBuffer(GL_ARRAY_BUFFER);
+	}
+	PIXL_gl.deleteBuffers(1, &vbo);
+	vbo = 0;
+	memory = NULL;
+	staging.clear();
+	head = in_flight = frame_bytes = 0;
+}
+
+/**
+ * @brief Wait for the GPU until there are some free bytes in front of head
+ *
+ * More bytes than the capacity (a wrap skipping a long tail) wait for
+ * everything in flight, the whole ring is free then.
+ */
+void PIXL_VertexStream::reclaim(size_t bytes)
+{
+	if(in_flight + bytes <= capacity)
+		return;
+
+	// the older frames can't free enough on their own, fence what this
+	// one has drawn so far and wait for it too
+	if(frames.empty() || frame_bytes + bytes > capacity)
+		fence();
+
+	while(in_flight + bytes > capacity && !frames.empty()) {
+		Frame& f = frames.front();
+		glClientWaitSync(f.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ULL);
+		glDeleteSync(f.fence);
+		in_flight -= f.bytes;
+		frames.pop_front();
+	}
+}
+
+void PIXL_VertexStream::fence()
+{
+	Frame f;
+	f.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	f.bytes = frame_bytes;
+	frames.push_back(f);
+	frame_bytes = 0;
+}
+
+/**
+ * @brief Room for count vertices, valid until draw()
+ *
+ * @return NULL if they don't fit in the whole buffer
+ */
+PIXL_Vertex* PIXL_VertexStream::map(uint count)
+{
+	if(!vbo)
+		create();
+
+	size_t bytes = count*sizeof(PIXL_Vertex);
+	if(bytes > capacity) {
+		printf("Vertex stream: %u vertices don't fit in %u\n", count, getCapacity());
+		return NULL;
+	}
+
+	if(head + bytes > capacity) {
+		// the tail is too small, start over
+		if(persistent) {
+			size_t skipped = capacity - head;
+			reclaim(skipped + bytes);
+			in_flight += skipped;
+			frame_bytes += skipped;
+		} else {
+			// new storage, the GPU keeps the old one while it needs it
+			PIXL_gl.bindBuffer(GL_ARRAY_BUFFER, vbo);
+			glBufferData(GL_ARRAY_BUFFER, capacity, NULL, GL_STREAM_DRAW);
+			in_flight = frame_bytes = 0;
+		}
+		head = 0;
+	} else if(persistent) {
+		reclaim(bytes);
+	}
+
+	mapped_offset = head;
+	mapped_count = count;
+	head += bytes;
+	in_flight += bytes;
+	frame_bytes += bytes;
+	written += bytes;
+
+	return memory + mapped_offset/sizeof(PIXL_Vertex);
+}
+
+/**
+ * @brief Draw the vertices of the last map()
+ */
+void PIXL_VertexStream::draw(GLenum mode)
+{
+	if(!mapped_count)
+		return;
+
+	PIXL_gl.bindBuffer(GL_ARRAY_BUFFER, vbo);
+	if(!persistent)
+		glBufferSubData(GL_ARRAY_BUFFER, mapped_offset, mapped_count*sizeof(PIXL_Vertex), memory + mapped_offset/sizeof(PIXL_Vertex));
+
+	// the pointers of other arrays may be in use, set them every time
+	PIXL_gl.enableClientState(GL_VERTEX_ARRAY);
+	glVertexPointer(2, GL_FLOAT, sizeof(PIXL_Vertex), (GLvoid*)offsetof(PIXL_Vertex, x));
+	PIXL_gl.enableClientState(GL_TEXTURE_COORD_ARRAY);
+	glTexCoordPointer(2, GL_FLOAT, sizeof(PIXL_Vertex), (GLvoid*)offsetof(PIXL_Vertex, s));
+	PIXL_gl.enableClientState(GL_COLOR_ARRAY);
+	glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(PIXL_Vertex), (GLvoid*)offsetof(PIXL_Vertex, color));
+
+	glDrawArrays(mode, mapped_offset/sizeof(PIXL_Vertex), mapped_count);
+
+	// the colour array would leak into the draws of the game
+	PIXL_gl.disableClientState(GL_COLOR_ARRAY);
+	glColor4f(1.f,1.f,1.f,1.f);
+
+	mapped_count = 0;
+}
+
+/**
+ * @brief Draw a white textured quad, the usual sprite
+ */
+void PIXL_VertexStream::quad(float x0, float y0, float x1, float y1, float s0, float t0, float s1, float t1)
+{
+	PIXL_Vertex* v = map(4);
+	v[0].x = x0; v[0].y = y0; v[0].s = s0; v[0].t = t0;
+	v[1].x = x0; v[1].y = y1; v[1].s = s0; v[1].t = t1;
+	v[2].x = x1; v[2].y = y1; v[2].s = s1; v[2].t = t1;
+	v[3].x = x1; v[3].y = y0; v[3].s = s1; v[3].t = t0;
+	memset(v[0].color, 255, 4);
+	memset(v[1].color, 255, 4);
+	memset(v[2].color, 255, 4);
+	memset(v[3].color, 255, 4);
+	draw(GL_QUADS);
+}
+
+/**
+ * @brief Draw a w*h quad transformed by m, in white
+ */
+void PIXL_VertexStream::quad(const PIXL_Affine& m, float w, float h, float s0, float t0, float s1, float t1)
+{
+	PIXL_Vertex* v = map(4);
+	v[0].x = m.x; v[0].y = m.y; v[0].s = s0; v[0].t = t0;
+	v[1].x = m.getX(0, h); v[1].y = m.getY(0, h); v[1].s = s0; v[1].t = t1;
+	v[2].x = m.getX(w, h); v[2].y = m.getY(w, h); v[2].s = s1; v[2].t = t1;
+	v[3].x = m.getX(w, 0); v[3].y = m.getY(w, 0); v[3].s = s1; v[3].t = t0;
+	memset(v[0].color, 255, 4);
+	memset(v[1].color, 255, 4);
+	memset(v[2].color, 255, 4);
+	memset(v[3].color, 255, 4);
+	draw(GL_QUADS);
+}
+
+/**
+ * @brief Fence what this frame wrote
+ */
+void PIXL_VertexStream::endFrame()
+{
+	last_written = written;
+	written = 0;
+	if(!vbo || !frame_bytes)
+		return;
+
+	if(persistent)
+		fence();
+	else
+		frame_bytes = 0;
+}
+
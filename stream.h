@@ -0,0 +1,105 @@
+/* 
+ * Copyright (C) 2012 - Brian Gomes Bascoy
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ * 
+ */
+
+#ifndef _PIXL_STREAM_H_
+#define _PIXL_STREAM_H_
+
+#include <stddef.h>
+#include <deque>
+#include <vector>
+#include <GL/glew.h>
+
+#include "config.h"
+#include "glstate.h"
+#include "scene.h"
+
+/**
+ * @brief Vertex of every dynamic draw, 20 bytes
+ */
+typedef struct {
+	GLfloat x;
+	GLfloat y;
+	GLfloat s;
+	GLfloat t;
+	GLubyte color[4];
+} PIXL_Vertex;
+
+
+/**
+ * @brief Ring buffer for transient vertices
+ *
+ * All dynamic geometry (sprites, layers, FBOs, particles...) is written
+ * into one big vertex buffer with a bump pointer: map() returns room for
+ * some vertices, draw() draws them. With ARB_buffer_storage the buffer is
+ * persistently mapped and written directly, a fence at the end of every
+ * frame tells when the GPU is done with a region so the ring can go
+ * around it again. Without it the vertices are staged and uploaded with
+ * glBufferSubData(), orphaning the buffer each time the ring wraps.
+ *
+ *   PIXL_Vertex* v = PIXL_stream.map(4);
+ *   ... fill v[0..3]
+ *   PIXL_stream.draw(GL_QUADS);
+ *
+ * The buffer is created by the first map(), PIXL_App calls endFrame()
+ * after every swap and release() before the context goes away.
+ */
+class PIXL_VertexStream {
+	public:
+		PIXL_VertexStream(size_t bytes = 4*1024*1024);
+		~PIXL_VertexStream() { release(); }
+		PIXL_Vertex* map(uint count);
+		void draw(GLenum mode);
+		void quad(float x0, float y0, float x1, float y1, float s0, float t0, float s1, float t1);
+		void quad(const PIXL_Affine& m, float w, float h, float s0, float t0, float s1, float t1);
+		void endFrame();
+		void release();
+		uint getCapacity() { return capacity/sizeof(PIXL_Vertex); }
+		bool isPersistent() { return persistent; }
+		size_t getFrameBytes() { return last_written; }
+	private:
+		PIXL_VertexStream(const PIXL_VertexStream&);
+		PIXL_VertexStream& operator=(const PIXL_VertexStream&);
+
+		typedef struct {
+			GLsync fence;
+			size_t bytes; // written by that frame, with the bytes skipped when wrapping
+		} Frame;
+
+		void create();
+		void reclaim(size_t bytes);
+		void fence();
+
+		GLuint vbo;
+		size_t capacity;
+		bool persistent; // ARB_buffer_storage
+		PIXL_Vertex* memory; // persistent mapping, or the staging area
+		std::vector<PIXL_Vertex> staging;
+		size_t head; // next free byte
+		size_t in_flight; // bytes the GPU may still read, current frame included
+		size_t frame_bytes; // of the current frame not fenced yet
+		size_t written; // by the current frame, for getFrameBytes()
+		size_t last_written;
+		std::deque<Frame> frames; // fenced, oldest first
+		size_t mapped_offset; // of the last map()
+		uint mapped_count;
+};
+
+extern PIXL_VertexStream PIXL_stream;
+
+#endif // _PIXL_STREAM_H_
+
@@ -8,19 +8,6 @@
 #include <libxml/xmlreader.h>
 #include <libxml/xmlstring.h>
 
-typedef struct {
-	unsigned int w;
-	unsigned int h;
-} PIXL_T_size;
-
-typedef struct {
-	std::vector<int> tile; // tile number starting from 1
-	PIXL_T_size tile_size; // in pixels
-	std::string tileset_file; // atlas file name
-	PIXL_T_size tileset_size; // in tiles
-	PIXL_T_size size; // in tiles
-} PIXL_T_map;
-
 inline bool isCurrentElementX(xmlTextReaderPtr reader, const char* elem)
 {
 	return 0 == xmlStrcmp(xmlTextReaderConstName(reader),(xmlChar*)elem);
@@ -74,25 +61,36 @@ class Game: public PIXL_App {
 		void update();
 		void render();
 	private:
+		static void drawScene(void* graph) { ((PIXL_RenderGraph*)graph)->execute(); }
+		static void drawMap(void* game) { ((Game*)game)->drawMap(); }
+		void drawMap();
+
 		PIXL_Layer *mylayer;
 
 		PIXL_Layer *mylayer2;
+		PIXL_Text *mytitle;
 		PIXL_Text *mytext;
+		char mystats[512]; // refreshed with the fps
+		PIXL_LayerJobs *mylayerjobs;
 
 		PIXL_Image *myimage;
-		std::stringstream mystring;
 		int frame_count;
 		int fps;
 		int mytime;
 
 		PIXL_Sprite *mysprite;
+		PIXL_SceneGraph myscene;
+		uint mypivot; // at the centre, mysprite orbits around it
+		uint myorbit;
 
 		PIXL_Animation *myanimation;
 
 		double p; //pi phase
 
 		PIXL_FBO *myfbo;
-		PIXL_FBO *myfbo2;
+		PIXL_RenderGraph *mygraph;
+		PIXL_RenderQueue *myqueue;
+		PIXL_Camera *mycamera;
 
 		/***************/
 		/* LOADING MAP */
@@ -112,10 +110,13 @@ class Game: public PIXL_App {
 
 Game::Game()
 {
-	mylayer = new PIXL_Layer(*PIXL_config.w, *PIXL_config.h);
+	mylayer = new PIXL_Layer();
 
-	mylayer2 = new PIXL_Layer(*PIXL_config.w, *PIXL_config.h);
-	mytext = new PIXL_Text(mylayer2, "fonts/ProggyTiny.ttf", 12, 10, 10);
+	mylayer2 = new PIXL_Layer();
+	mytitle = new PIXL_Text(mylayer2, "fonts/ProggyTiny.ttf", 12, 10, 10);
+	mytext = new PIXL_Text(mylayer2, "fonts/ProggyTiny.ttf", 12, 10, 24);
+	mystats[0] = '\0';
+	mylayerjobs = new PIXL_LayerJobs(getJobs());
 
 	myimage = new PIXL_Image(mylayer, "bullet.png");
 	frame_count=0;
@@ -123,15 +124,23 @@ Game::Game()
 	mytime=SDL_GetTicks();
 
 	mysprite = new PIXL_Sprite("test.png");
+	mypivot = myscene.add();
+	myscene.setPos(mypivot, *PIXL_config.w*0.5, *PIXL_config.h*0.5);
+	myorbit = myscene.add(mypivot);
+	myscene.setPos(myorbit, 100, 0);
 
 	myanimation = new PIXL_Animation("cats.png", 23, 23, 100);
 	myanimation->play(3,true);
 
 	myfbo = new PIXL_FBO();
-	myfbo2 = new PIXL_FBO();
 
-	myfbo->shader = PIXL_loadShader("gbh.glsl");
-	myfbo2->shader = PIXL_loadShader("gbv.glsl");
+	mygraph = new PIXL_RenderGraph();
+	mygraph->setTexture("scene", myfbo->getTexture());
+	mygraph->addPass(PIXL_loadShader("gbh.glsl"), "scene", "blur");
+	mygraph->addPass(PIXL_loadShader("gbv.glsl"), "blur", "screen");
+
+	myqueue = new PIXL_RenderQueue();
+	mycamera = new PIXL_Camera();
 
 	/***************/
 	/* LOADING MAP */
@@ -164,9 +173,9 @@ Game::Game()
 	}
 
 	glGenBuffers(1, &vbo);
-	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	PIXL_gl.bindBuffer(GL_ARRAY_BUFFER, vbo);
 	glBufferData(GL_ARRAY_BUFFER, sizeof(myarray), myarray, GL_STATIC_DRAW);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	PIXL_gl.bindBuffer(GL_ARRAY_BUFFER, 0);
 
 	/*******************/
 	/* TEXCOORDS ARRAY */
@@ -191,9 +200,9 @@ Game::Game()
 	}
 
 	glGenBuffers(1, &vbo2);
-	glBindBuffer(GL_ARRAY_BUFFER, vbo2);
+	PIXL_gl.bindBuffer(GL_ARRAY_BUFFER, vbo2);
 	glBufferData(GL_ARRAY_BUFFER, sizeof(myarray2), myarray2, GL_DYNAMIC_DRAW);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	PIXL_gl.bindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
 void Game::update()
@@ -206,51 +215,81 @@ void Game::update()
 
 void Game::render()
 {
-	myfbo->bind();
-
-	glClear( GL_COLOR_BUFFER_BIT );
-	mylayer->clear();
-	mylayer2->clear();
-
-	for(int i=0; i<100; i++){
-		myimage->draw(320+sin(sin(p)*4*M_PI*i/100)*i*2,240+cos(sin(p)*4*M_PI*i/100)*i*2);
-	}
-
-	mylayer->draw();
-
-	mysprite->draw(*PIXL_config.w*0.5+(100*cos(p*2)),*PIXL_config.h*0.5+(100*sin(p*2)));
-
-	myfbo->draw(myfbo2);
-	myfbo2->draw();
-
 	frame_count++;
 	if(frame_count==20){
 		fps=1000/((SDL_GetTicks()-mytime)/frame_count);
 		mytime=SDL_GetTicks();
 		frame_count=0;
+		// the stats change with the fps only, PIXL_Text skips the other frames
+		snprintf(mystats, sizeof(mystats), "FPS: %d\n%g\nGL calls: %u (%u saved)\nQueue: %u draws, %u state changes\nCamera: %u drawn, %u culled\nFrame arena: %lu KB",
+				fps, SDL_GetTicks()/1000.f, PIXL_gl.getIssued(), PIXL_gl.getSaved(),
+				myqueue->getDrawCalls(), myqueue->getStateChanges(), mycamera->getDrawn(), mycamera->getCulled(),
+				(unsigned long)(PIXL_FrameArena::getTotalHighWater()/1024));
 	}
-	mystring.str("");
-	mystring << "FPS: " << fps;
-	mystring << "\n" << SDL_GetTicks()/1000.f;
-	mytext->print(mystring.str().c_str());
-	mylayer2->draw();
-
-	myanimation->draw(50,50);
 
+	// both layers are drawn by the workers while we queue the rest
+	mylayerjobs->record(mylayer, [this]() {
+		mylayer->clear();
+		for(int i=0; i<100; i++){
+			myimage->draw(320+sin(sin(p)*4*M_PI*i/100)*i*2,240+cos(sin(p)*4*M_PI*i/100)*i*2);
+		}
+	});
+	// both texts share mylayer2, each one only redraws when it changes
+	mylayerjobs->record(mylayer2, [this]() {
+		mytitle->print("PIXL test");
+		mytext->print(mystats);
+	});
+	mylayerjobs->run();
+
+	// the scene, blurred to the screen by mygraph
+	myqueue->setTarget(myfbo, true);
+	myqueue->setLayer(1);
+	mycamera->setRotation(sin(p)*10);
+	myqueue->setCamera(mycamera);
+	myscene.setRotation(mypivot, p*2*180/M_PI);
+	myscene.setRotation(myorbit, -p*2*180/M_PI); // keep the sprite upright
+	myscene.update();
+	mysprite->draw(myqueue, myscene.getWorld(myorbit));
+	myqueue->setCamera(NULL);
+
+	myqueue->setTarget(NULL);
+	myqueue->setLayer(0);
+	myqueue->call(drawScene, mygraph);
+
+	// HUD: the text (depth 0), the animation over it and the map on top
+	myqueue->setLayer(1);
+	myqueue->setDepth(1);
+	myanimation->draw(myqueue, 50,50);
+	myqueue->setDepth(2);
+	myqueue->call(drawMap, this);
+	myqueue->setDepth(0);
+
+	mylayerjobs->wait();
+	myqueue->setTarget(myfbo, true);
+	myqueue->setLayer(0);
+	mylayer->draw(myqueue);
+	myqueue->setTarget(NULL);
+	myqueue->setLayer(1);
+	mylayer2->draw(myqueue);
+
+	myqueue->flush();
+}
 
+void Game::drawMap()
+{
 	/////////////////////////////////___________________________________VBO
 
-	glBindBuffer(GL_ARRAY_BUFFER, vbo);
-	glEnableClientState(GL_VERTEX_ARRAY);
+	PIXL_gl.bindBuffer(GL_ARRAY_BUFFER, vbo);
+	PIXL_gl.enableClientState(GL_VERTEX_ARRAY);
 	glVertexPointer(2, GL_INT, 0, 0);
-	glBindBuffer(GL_ARRAY_BUFFER, vbo2);
-	glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+	PIXL_gl.bindBuffer(GL_ARRAY_BUFFER, vbo2);
+	PIXL_gl.enableClientState(GL_TEXTURE_COORD_ARRAY);
 	glTexCoordPointer(2, GL_FLOAT, 0, 0);
 	ttexture->bind();
 	glDrawArrays(GL_QUADS, 0, 25*15*4);
 	ttexture->unbind();
-	glDisableClientState(GL_VERTEX_ARRAY);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	PIXL_gl.disableClientState(GL_VERTEX_ARRAY);
+	PIXL_gl.bindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
 